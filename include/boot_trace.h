@@ -0,0 +1,57 @@
+/* Copyright (c) 2018 Cameron A. Craig, MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ * BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * @file boot_trace.h
+ * @author Cameron A. Craig
+ * @date 15 Mar 2018
+ * @copyright 2018 Cameron A. Craig
+ * @brief Records when each stage of start up begins, to see where boot time goes.
+ */
+
+#ifndef TC_BOOT_TRACE_H
+#define TC_BOOT_TRACE_H
+
+#include <stdint.h>
+#include "cli.h"
+
+/* Most stages that can be recorded, later stages are dropped */
+#define BOOT_TRACE_MAX_STAGES 24
+
+/**
+* @brief Record that a stage of start up is beginning.
+* @details Only stores the time and the name pointer, so name must be a
+*          string literal. The stage ends when the next one begins.
+* @param [in] name Name of the stage.
+*/
+void boot_trace(const char *name);
+
+/**
+* @brief Record the first command sent to the ESCs, ignored after the first call.
+* @details Cheap enough to call from every control loop iteration.
+*/
+void boot_trace_first_output(void);
+
+/**
+* @brief Print the time each stage started and how long it took.
+* @details Times are from when the microsecond ticker started, which it does
+*          on first use, no later than the first stage at the top of main().
+*          Time from reset to then (C library and RTOS start up, static
+*          constructors) is not included. Call once, at the end of boot.
+*/
+void boot_trace_print(LockedSerial *serial);
+
+#endif  // TC_BOOT_TRACE_H
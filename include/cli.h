@@ -0,0 +1,105 @@
+/* Copyright (c) 2018 Cameron A. Craig, MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ * BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * @file cli.h
+ * @author Cameron A. Craig
+ * @date 24 Feb 2018
+ * @copyright 2018 Cameron A. Craig
+ * @brief Interrupt driven line editor for the USB serial command line interface.
+ */
+
+#ifndef TC_CLI_H
+#define TC_CLI_H
+
+#include "mbed.h"
+#include "rtos.h"
+#include <stddef.h>
+
+/** @class LockedSerial
+    @brief RawSerial that may be read from an ISR, but still serialises
+           each printf()/puts() call from threads, like Serial does.
+*/
+class LockedSerial : public RawSerial {
+  public:
+  /**
+  * @param [in] tx Transmit pin.
+  * @param [in] rx Receive pin.
+  * @param [in] mutex Held for each write, shared with anything else that
+  *                   writes to the port (thread_args_t::mutex.pc_serial).
+  */
+  LockedSerial(PinName tx, PinName rx, Mutex *mutex) : RawSerial(tx, rx), _mutex(mutex) {}
+
+  /**
+  * @brief Hold the port across several calls, e.g. to write a whole frame.
+  */
+  void acquire(void) { lock(); }
+
+  /**
+  * @brief Release the port after acquire().
+  */
+  void release(void) { unlock(); }
+
+  protected:
+  /**
+  * @brief Take the port mutex, unless called from an ISR.
+  */
+  virtual void lock(void);
+
+  /**
+  * @brief Release the port mutex, unless called from an ISR.
+  */
+  virtual void unlock(void);
+
+  private:
+  Mutex *_mutex;
+};
+
+/**
+* @brief Attach the RX interrupt that edits and echoes the current line.
+* @details Binary frames (see link_usb_feed()) are passed to the frame
+*          parser without being echoed.
+* @param [in] serial USB serial port.
+*/
+void cli_init(RawSerial *serial);
+
+/**
+* @brief Block (using no CPU) until a complete line has been entered.
+* @param [out] line Buffer to copy the null terminated line into.
+* @param [in] size Size of line, at least CLI_LINE_LENGTH.
+* @return Length of the line.
+*/
+size_t cli_read_line(char *line, size_t size);
+
+/**
+* @return Number of lines dropped because no task was reading them.
+*/
+uint32_t cli_overruns(void);
+
+/**
+* @brief Write out the characters the RX interrupt has echoed since the last
+*        call. Called by the log task, the only thread that may flush.
+* @param [in] serial USB serial port, held for the whole echo.
+*/
+void cli_echo_flush(LockedSerial *serial);
+
+/**
+* @return Number of echoed characters dropped because the echo was not
+*         written out in time.
+*/
+uint32_t cli_echo_dropped(void);
+
+#endif //TC_CLI_H
@@ -27,6 +27,7 @@
 #define INCLUDE_COMMAND_H_
 
 #include "./tele_param.h"
+#include "./settings.h"
 
 /**
  * Available commands (used for serial interface).
@@ -39,9 +40,53 @@ typedef enum  {
   STATUS,
   GET_PARAM,
   SET_PARAM,
-  CALIBRATE_CHANNELS
+  CALIBRATE_CHANNELS,
+  TASK_CONTROL,
+  GET_PARAMS,
+  CONFIG,
+  MEMORY
 } command_id_t;
 
+/**
+ * Sub-commands of the task command.
+ */
+typedef enum {
+  TASK_OP_LIST = 0,
+  TASK_OP_STOP,
+  TASK_OP_START,
+  TASK_OP_RATE,
+  TASK_OP_STACK
+} task_op_t;
+
+/**
+ * Sub-commands of the cfg command.
+ */
+typedef enum {
+  CONFIG_OP_LIST = 0,
+  CONFIG_OP_GET,
+  CONFIG_OP_SET
+} config_op_t;
+
+/**
+ * Where a command came from, and so where its response should be sent.
+ */
+typedef enum {
+  LINK_USB = 0,
+  LINK_ESP8266,
+  /*! Framed binary requests on the USB port, e.g. from a test rig. */
+  LINK_USB_BINARY
+} link_id_t;
+
+/**
+ * Which queue a command is executed from.
+ */
+typedef enum {
+  /*! Run as soon as possible, ahead of the control loop (e.g. disarm). */
+  COMMAND_PRIORITY_SAFETY = 0,
+  /*! Run when the control loop is idle. */
+  COMMAND_PRIORITY_NORMAL
+} command_priority_t;
+
 /**
  * Stores command parameters.
  */
@@ -49,6 +94,11 @@ typedef struct {
   command_id_t id;
   const char *name;
 
+  /**
+   * Selects the queue and so the thread the command runs in.
+   */
+  command_priority_t priority;
+
   /**
    * Used if the command gets or sets a parameter.
    */
@@ -57,13 +107,34 @@ typedef struct {
   /**
    * Stores a value as one of a number of types.
    */
-  union {
-    float f;
-    int i;
-    char c;
-    bool b;
-    const char *s;
-  } value;
+  tele_value_t value;
+
+  /**
+   * Used by the task command, value.i holds the rate for TASK_OP_RATE.
+   */
+  task_op_t task_op;
+  unsigned task_id;
+
+  /**
+   * Used by the getall command, bit n selects tele_command_id_t n.
+   */
+  uint64_t param_mask;
+
+  /**
+   * Used by the cfg command, value holds the value for CONFIG_OP_SET.
+   */
+  config_op_t config_op;
+  const setting_t *setting;
+
+  /**
+   * Link the command arrived on, which is also where the response is sent.
+   */
+  link_id_t link;
+
+  /**
+   * Request ID given by the sender, echoed in the response.
+   */
+  uint8_t seq;
 } command_t;
 
 #endif  // INCLUDE_COMMAND_H_
@@ -29,18 +29,49 @@
 #include "command.h"
 
 static const command_t available_commands[] = {
-  {.id = FULLY_DISARM, .name = "disarm"},
-  {.id = PARTIAL_DISARM, .name = "decarm"},
-  {.id = PARTIAL_ARM, .name = "incarm"},
-  {.id = FULLY_ARM, .name = "arm"},
-  {.id = STATUS, .name = "status"},
-  {.id = GET_PARAM, .name = "get"},
-  {.id = SET_PARAM, .name = "set"},
-  {.id = CALIBRATE_CHANNELS, .name = "calibrate"}
+  {.id = FULLY_DISARM, .name = "disarm", .priority = COMMAND_PRIORITY_SAFETY},
+  {.id = PARTIAL_DISARM, .name = "decarm", .priority = COMMAND_PRIORITY_SAFETY},
+  {.id = PARTIAL_ARM, .name = "incarm", .priority = COMMAND_PRIORITY_NORMAL},
+  {.id = FULLY_ARM, .name = "arm", .priority = COMMAND_PRIORITY_NORMAL},
+  {.id = STATUS, .name = "status", .priority = COMMAND_PRIORITY_NORMAL},
+  {.id = GET_PARAM, .name = "get", .priority = COMMAND_PRIORITY_NORMAL},
+  {.id = SET_PARAM, .name = "set", .priority = COMMAND_PRIORITY_NORMAL},
+  {.id = CALIBRATE_CHANNELS, .name = "calibrate", .priority = COMMAND_PRIORITY_NORMAL},
+  {.id = TASK_CONTROL, .name = "task", .priority = COMMAND_PRIORITY_NORMAL},
+  {.id = GET_PARAMS, .name = "getall", .priority = COMMAND_PRIORITY_NORMAL},
+  {.id = CONFIG, .name = "cfg", .priority = COMMAND_PRIORITY_NORMAL},
+  {.id = MEMORY, .name = "mem", .priority = COMMAND_PRIORITY_NORMAL}
 };
 
 #define NUM_COMMANDS (sizeof(available_commands) / sizeof(command_t))
 
+/* Longest command is "task rate <name> <hz>" */
+#define MAX_COMMAND_TOKENS 4
+
+/**
+ * A word within a command string, which is not copied or terminated.
+ */
+typedef struct {
+  const char *ptr;
+  size_t len;
+} token_t;
+
+/**
+* @brief Build the command name lookup table, call once before
+*        command_generate().
+* @return True if a perfect hash was found for the command names.
+*/
+bool command_init(void);
+
+/**
+* @brief Split a command string into space separated tokens, in place.
+* @param [in] buffer Null terminated command string.
+* @param [out] tokens Tokens found, pointing into buffer.
+* @param [in] max_tokens Size of tokens.
+* @return Number of tokens found, or max_tokens + 1 if there were too many.
+*/
+size_t command_tokenize(const char *buffer, token_t *tokens, size_t max_tokens);
+
 /**
 * @brief Return command as a string (meaningful name)
 * @param [in] id Identifier for command being dealt with.
@@ -49,10 +80,42 @@ const char * command_get_str(command_id_t id);
 
 /**
 * @brief Produce a command_t from a raw command string.
+* @details Command and parameter names must match exactly. Nothing is printed,
+*          so this is safe to call from any thread.
 * @param [out] command The command to populate.
-* @param [in] buffer Command string.
+* @param [in] buffer Null terminated command string.
+* @return RET_OK if buffer is a valid command, otherwise RET_ERROR.
 */
-int command_generate(command_t *command, char *buffer);
+int command_generate(command_t *command, const char *buffer);
+
+/**
+* @brief Queue a command for execution according to its priority.
+* @details Safety commands go to the safety queue, which is served by a thread
+*          above the control loop. Everything else is served below it. Never
+*          blocks, so may be called from an ISR.
+* @param [in] targs Provides access to the command queues.
+* @param [in] command The command to queue, it is copied.
+* @return RET_OK if queued, RET_ERROR if the queue is full.
+*/
+int command_submit(thread_args_t *targs, const command_t *command);
+
+/**
+* @brief Check whether a command may be run from the link it arrived on.
+* @details Arming commands are safety critical, so may only be typed on the
+*          USB command line. Binary USB requests may disarm but only arm if
+*          USB_BINARY_ARMING is defined, for test rigs.
+* @param [in] command The command to check.
+* @return True if the command may be executed.
+*/
+bool command_allowed(const command_t *command);
+
+/**
+* @brief Send the result of a command back to the link it arrived on.
+* @param [in] command The executed command.
+* @param [in] err Return code from command_execute().
+* @param [in] targs Provides access to the link serial ports.
+*/
+void command_respond(const command_t *command, int err, thread_args_t *targs);
 
 /**
 * @brief Carry out the function intended by the command.
@@ -97,12 +160,21 @@ int command_fully_arm(command_t *command, thread_args_t *targs);
 int command_status(command_t *command, thread_args_t *targs);
 
 /**
-* @brief Return value of parameter to console.
-* @param [in] command The command being executed.
+* @brief Read the value of a parameter into command->value.
+* @param [in/out] command The command being executed.
 * @return RET_OK on success, RET_ERROR on error.
 */
 int command_get_param(command_t *command, thread_args_t *targs);
 
+/**
+* @brief Check the parameters selected by command->param_mask.
+* @details The values are read when the response is sent, so that a bulk
+*          request never needs more than one command_t.
+* @param [in] command The command being executed.
+* @return RET_OK if the mask selects only existing parameters.
+*/
+int command_get_params(command_t *command, thread_args_t *targs);
+
 /**
 * @brief Set a paramert to a specified value.
 * @param [in] command The command being executed.
@@ -117,4 +189,33 @@ int command_set_param(command_t *command, thread_args_t *targs);
 */
 int command_calibrate_channels(command_t *command, thread_args_t *targs);
 
+/**
+* @brief List, stop, start or change the rate of a task.
+* @details "task list" prints each task's stack use, CPU share and loop rate
+*          since the previous "task list". "task stack" prints the most stack
+*          each task has used and a stack size to give it.
+* @param [in] command The command being executed.
+* @return RET_OK on success, RET_NOT_ALLOWED if the task can't be changed.
+*/
+int command_task(command_t *command, thread_args_t *targs);
+
+/**
+* @brief Print heap use, the ISR stack peak and the stack peak of each task.
+* @param [in] command The command being executed.
+* @return RET_OK.
+*/
+int command_memory(command_t *command, thread_args_t *targs);
+
+/**
+* @brief List, read or change a run time setting.
+* @details "cfg set" checks the value against the setting's range and the
+*          other settings, then publishes it to the control loop in one step.
+*          The drive and weapon modes can only be set while disarmed.
+* @param [in/out] command The command being executed, a read value is
+*                 returned in command->value.
+* @return RET_OK on success, RET_OUT_OF_RANGE or RET_CONFLICT if the value
+*         is rejected, RET_DISARM_FIRST if it must wait until disarmed.
+*/
+int command_config(command_t *command, thread_args_t *targs);
+
 #endif //TC_COMMANDS_H
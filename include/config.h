@@ -27,19 +27,33 @@
 #ifndef TC_CONFIG_H
 #define TC_CONFIG_H
 
+/* Run the control loop, failsafe, arming, LEDs and telemetry sampling as
+   slots of a single executive released by a timer interrupt, rather than
+   as a thread each. See task_executive(). */
+//#define CYCLIC_EXECUTIVE
+
 /* The following macros are used to enable and disable tasks at
    preprocessing time. */
 
-// #define TASK_READ_SERIAL
-// #define TASK_PROCESS_COMMANDS
-#define TASK_LED_STATE
+#define TASK_READ_SERIAL
+#define TASK_PROCESS_COMMANDS
+#define TASK_SAFETY_COMMANDS
+#define TASK_EVENTS
+#ifdef CYCLIC_EXECUTIVE
+#define TASK_EXECUTIVE
+#else
 #define TASK_MOTOR_DRIVE
 #define TASK_ARMING
 #define TASK_FAILSAFE
-#define TASK_CALC_ORIENTATION
 #define TASK_COLLECT_TELEMETRY
+#endif
+#define TASK_CALC_ORIENTATION
 #define TASK_STREAM_TELEMETRY
 #define TASK_CALIBRATE_CHANNELS
+#define TASK_FLIGHT_LOG
+#define TASK_STACK_MONITOR
+#define TASK_SUPERVISOR
+#define TASK_LOG
 //#define TASK_DEBUG
 
 // #define DEVICE_BNO055
@@ -70,9 +84,21 @@
 #define WEAPON_ESC_OUT_2_PIN p25
 #define WEAPON_ESC_OUT_3_PIN p26 // Extra pin if we add 3rd motor
 
+/* ESC pulses, all outputs share one PWM period */
+#define ESC_PWM_PERIOD_US 20000
+// Pulse width sent to a stopped ESC
+#define DRIVE_ESC_STOP_US 1500
+#define WEAPON_ESC_STOP_US 1000
+
 #define ESP_TX p28
 #define ESP_RX p27
 
+// Weapon motor tachometers, must be able to interrupt (port 0 or 2 pins).
+// These share the CAN1 pins, so cannot be used with the VESC CAN comms.
+#define WEAPON_TACHO_1_PIN p30
+#define WEAPON_TACHO_2_PIN p29
+#define WEAPON_TACHO_3_PIN NC // No free interrupt pin for a 3rd motor
+
 /* End of Pin Assignments */
 
 #define RC_NUMBER_CHANNELS 6
@@ -81,6 +107,11 @@
 // 150ms increments
 #define NO_SIGNAL_TIMEOUT 70
 #define WATCHDOG_TIME_SECONDS 1.0
+// Time from the start of main() to restored ESC outputs that a warm restart aims
+// for. The time from the watchdog reset to main() is not measured.
+#define WARM_START_TARGET_MS 100
+// Period of the supervisor, which kicks the watchdog while all tasks are alive
+#define SUPERVISOR_PERIOD_MS 50
 
 #define RC_ARM_CHANNEL_1 90
 #define RC_ARM_CHANNEL_2 90
@@ -97,11 +128,97 @@
 
 
 #define COMMAND_QUEUE_LEN 100
+// Disarm commands skip the main queue, only a few are ever outstanding
+#define SAFETY_COMMAND_QUEUE_LEN 8
+
+/* Command line interface */
+// USB serial, also carries binary requests, so raise it for test rigs.
+// At 115200 the port carries roughly a thousand small requests per second.
+#define USB_SERIAL_BAUD 115200
+// Binary requests may disarm, but not arm, unless a test rig needs them to.
+// A program on the PC can then spin up the robot, so leave this off unless
+// the robot is on a bench with its weapon removed.
+// #define USB_BINARY_ARMING
+// Longest line that can be entered, including the terminator
+#define CLI_LINE_LENGTH 64
+// Completed lines waiting to be parsed
+#define CLI_LINE_QUEUE_LEN 4
+// Echoed characters waiting for the log task to write them, a power of two.
+// Erasing a full line with Ctrl-U echoes three per character.
+#define CLI_ECHO_LEN 256
 
 #define MAIL_TIMEOUT_MS 1
 
+/* Control loop */
+// Period of the motor drive task, receiver to ESC latency is at most this
+#define CONTROL_LOOP_PERIOD_MS 5
+// Period of the receiver signal loss check
+#define FAILSAFE_PERIOD_MS 10
+// Period of the interrupt that cuts off the ESCs of a stalled receiver
+#define ESC_CUTOFF_TICK_US 1000
+// Tachometer pulses per weapon revolution (magnets, or motor pole pairs)
+#define WEAPON_TACHO_PULSES_PER_REV 7
+// A weapon with no tachometer pulse for this long is stopped
+#define WEAPON_TACHO_TIMEOUT_MS 100
+// Fastest change of weapon throttle in RPM hold mode (% per second)
+#define WEAPON_THROTTLE_SLEW 200
+// Period of the arming switch check
+#define ARMING_PERIOD_MS 1000
+// Step of the LED ripple shown while only the weapon is armed
+#define LED_RIPPLE_PERIOD_MS 100
+
 #define NUM_SURFACE_LEDS 4
 
+/* Telemetry */
+// Parameters are sampled (and aggregated) at this period
+#define TELEMETRY_SAMPLE_PERIOD_MS 50
+// Aggregates are streamed to the ESP8266 and reset at this period
+#define TELEMETRY_STREAM_PERIOD_MS 1000
+
+/* Stack monitor */
+#define STACK_MONITOR_PERIOD_MS 1000
+// Recommended stack sizes leave this much headroom above the peak, and a
+// task whose peak leaves less than this free is reported as near overflow
+#define STACK_MARGIN_PERCENT 25
+
+/* Channel calibration */
+#define CALIBRATION_TIME_MS 10000
+// Time between samples of each channel
+#define CALIBRATION_TICK_MS 100
+
+/* Logging */
+// Most verbose messages compiled in: 0 none, 1 errors, 2 warnings, 3 info, 4 debug
+#define LOG_LEVEL 3
+// Messages waiting for the log writer, per channel. The writer runs at low
+// priority, so debug must hold every task's "started task" message at boot.
+#define LOG_ALERT_QUEUE_LEN 4
+#define LOG_CONSOLE_QUEUE_LEN 16
+#define LOG_DEBUG_QUEUE_LEN 20
+// Longest formatted message, longer ones are cut short
+#define LOG_QUEUE_LINE_LENGTH 160
+// The log writer also wakes this often, in case a wake up was missed
+#define LOG_QUEUE_IDLE_MS 100
+
+/* Event queue */
+// Events outstanding at once: one per queued task, plus starts and rate changes
+#define TASK_EVENT_QUEUE_LEN 16
+
+/* Arming state */
+// State changes kept for "status"
+#define STATE_HISTORY_LEN 8
+// Most functions that can be told of each state change
+#define STATE_MAX_SUBSCRIBERS 8
+
+/* Flight log */
+#define FLIGHT_LOG_PATH "/local/flight.log"
+#define FLIGHT_LOG_BLOCK_SIZE 512
+// Blocks buffered while the writer catches up, the control loop fills one at a time.
+// Nothing is written while armed (LocalFileSystem halts the CPU), so only the
+// newest blocks before a disarm are kept: 15 records, 0.3 s each at 50 Hz.
+#define FLIGHT_LOG_BLOCKS 4
+// Minimum time between records (20ms = 50 records per second)
+#define FLIGHT_LOG_PERIOD_MS 20
+
 // Default channel limits (RC0/Weapon)
 #define RC_0_CHAN_1_MIN   1069.0f
 #define RC_0_CHAN_1_MAX   1895.0f
@@ -44,4 +44,11 @@ void drive_2_wheel_differential(const void * targs);
 */
 void weapon_manual_throttle(const void * targs);
 
+/**
+* @brief Run a tick of RPM hold weapon mode.
+* @details The throttle stick sets a target RPM, which each weapon motor is
+*          held at by a fixed point PI controller on its tachometer.
+*/
+void weapon_rpm_hold(const void * targs);
+
 #endif
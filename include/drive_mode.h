@@ -51,7 +51,8 @@ typedef struct {
  * Available weapon control modes.
  */
 typedef enum {
-  WM_MANUAL_THROTTLE = 0
+  WM_MANUAL_THROTTLE = 0,
+  WM_RPM_HOLD
 } weapon_mode_id_t;
 
 /**
@@ -41,7 +41,8 @@ static volatile drive_mode_t drive_modes[] = {
 /* Weapon */
 
 static volatile weapon_mode_t weapon_modes[] = {
-  {.id = WM_MANUAL_THROTTLE, .name = "Manual Throttle", .weapon = weapon_manual_throttle }
+  {.id = WM_MANUAL_THROTTLE, .name = "Manual Throttle", .weapon = weapon_manual_throttle },
+  {.id = WM_RPM_HOLD, .name = "RPM Hold", .weapon = weapon_rpm_hold }
 };
 
 
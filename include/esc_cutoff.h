@@ -0,0 +1,80 @@
+/* Copyright (c) 2018 Cameron A. Craig, MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ * BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * @file esc_cutoff.h
+ * @author Cameron A. Craig
+ * @date 24 Mar 2018
+ * @copyright 2018 Cameron A. Craig
+ * @brief Stops the ESCs of a stalled receiver from a timer interrupt, ahead of the failsafe task.
+ */
+
+#ifndef TC_ESC_CUTOFF_H
+#define TC_ESC_CUTOFF_H
+
+#include "thread_args.h"
+
+/**
+ * Cutoff timing, see esc_cutoff_get_stats().
+ */
+typedef struct {
+  /*! Times a receiver stalled while its ESCs were armed. */
+  uint32_t cutoffs;
+  /*! Latest a stall was caught, after the stall timeout had passed
+      (measured). */
+  uint32_t worst_detect_us;
+  /*! Longest time taken by the interrupt to write the stopped pulse to the
+      match registers (measured). Does not include the wait for the next
+      PWM period, when the pulse actually changes. */
+  uint32_t worst_apply_us;
+  /*! Longest a receiver can be silent before its ESCs receive a stopped
+      pulse: the stall timeout, one tick, one tick more for a lost latch and
+      one PWM period. Worked out from the configuration, not measured. */
+  uint32_t bound_us;
+} esc_cutoff_stats_t;
+
+/**
+* @brief Start checking the receivers for a stall every ESC_CUTOFF_TICK_US.
+* @details When a receiver has been silent for longer than the stall timeout
+*   while its ESCs are armed, the interrupt sets their outputs to the stopped
+*   pulse, holds them there and raises the stall event, without waiting for
+*   the failsafe task. The hold is released once the receiver is back and
+*   the state machine has disarmed those ESCs, so they cannot restart until
+*   armed again.
+*   Call during boot, after the receivers, ESCs and state outputs.
+* @param [in] args Thread arguments.
+*/
+void esc_cutoff_init(thread_args_t *args);
+
+/**
+* @brief Follow a change to the stall timeout setting.
+* @param [in] timeout_ms Time without a pulse before a receiver is stalled.
+*/
+void esc_cutoff_set_timeout(int timeout_ms);
+
+/**
+* @brief ESC outputs being held stopped.
+* @return ESC_GATE_* bits.
+*/
+uint32_t esc_cutoff_outputs(void);
+
+/**
+* @brief Copy the cutoff timing.
+* @param [out] stats Timing since boot.
+*/
+void esc_cutoff_get_stats(esc_cutoff_stats_t *stats);
+
+#endif //TC_ESC_CUTOFF_H
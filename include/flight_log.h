@@ -0,0 +1,165 @@
+/* Copyright (c) 2018 Cameron A. Craig, MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ * BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * @file flight_log.h
+ * @author Cameron A. Craig
+ * @date 10 Feb 2018
+ * @copyright 2018 Cameron A. Craig
+ * @brief Double-buffered binary flight recorder, written to LocalFileSystem.
+ *
+ * LocalFileSystem is reached by semihosting: each file operation stops the
+ * CPU while the mbed interface chip serves it, so the control loop, the
+ * failsafe and every interrupt stop with it. Blocks are therefore held in
+ * RAM while the robot is armed and only written once it is disarmed, see
+ * flight_log_hold().
+ */
+
+#ifndef TC_FLIGHT_LOG_H
+#define TC_FLIGHT_LOG_H
+
+#include "mbed.h"
+#include "rtos.h"
+#include <stdint.h>
+#include "config.h"
+
+/* Identifies the start of each block in the log file ("TFLG"). */
+#define FLIGHT_LOG_MAGIC 0x474C4654U
+
+/* Signal sent to the writer thread when a block is ready. */
+#define FLIGHT_LOG_SIGNAL 0x01
+
+/**
+ * One snapshot of the control loop. Values are packed into small integer
+ * types so that a whole number of records fit in a block.
+ */
+typedef struct __attribute__((packed)) {
+  /*! us_ticker time the record was taken (wraps every ~71 minutes). */
+  uint32_t time_us;
+  /*! Arming state (state_t). */
+  uint8_t state;
+  /*! Bit 0: inverted. Bit 1: arming state changed since the last record. */
+  uint8_t flags;
+  /*! Bit n set if ESC output n was driven (not stopped). */
+  uint8_t esc_enabled;
+  uint8_t reserved;
+  /*! Control positions, 0 --> 100. */
+  uint8_t controls[RC_NUMBER_CONTROLLERS][RC_NUMBER_CHANNELS];
+  /*! ESC outputs, 0 --> 100, in COMMS_OUTPUT_* order. */
+  uint8_t outputs[6];
+  /*! Orientation in tenths of a degree. */
+  int16_t heading;
+  int16_t pitch;
+  int16_t roll;
+} flight_log_record_t;
+
+/**
+ * Header at the start of every block written to the log file.
+ */
+typedef struct __attribute__((packed)) {
+  uint32_t magic;
+  uint32_t sequence;
+  uint16_t record_size;
+  uint16_t record_count;
+  /*! Total blocks dropped before this one was written. */
+  uint32_t lost_blocks;
+} flight_log_header_t;
+
+#define FLIGHT_LOG_RECORDS_PER_BLOCK \
+  ((FLIGHT_LOG_BLOCK_SIZE - sizeof(flight_log_header_t)) / sizeof(flight_log_record_t))
+
+/**
+ * A block is exactly FLIGHT_LOG_BLOCK_SIZE bytes, so each fwrite() maps onto
+ * whole sectors of the LocalFileSystem.
+ */
+typedef struct {
+  flight_log_header_t header;
+  flight_log_record_t records[FLIGHT_LOG_RECORDS_PER_BLOCK];
+  uint8_t padding[FLIGHT_LOG_BLOCK_SIZE - sizeof(flight_log_header_t) -
+    FLIGHT_LOG_RECORDS_PER_BLOCK * sizeof(flight_log_record_t)];
+} flight_log_block_t;
+
+/**
+ * A ring of FLIGHT_LOG_BLOCKS blocks: the control loop fills one while the
+ * writer thread flushes the others, so a slow write can be absorbed. While
+ * the writer is held, the newest blocks are kept and the oldest overwritten.
+ */
+typedef struct {
+  flight_log_block_t block[FLIGHT_LOG_BLOCKS];
+
+  /*! Block currently being filled by the control loop. */
+  volatile uint32_t fill;
+  /*! Set by the control loop when a block is full, cleared by the writer. */
+  volatile bool ready[FLIGHT_LOG_BLOCKS];
+
+  /*! Thread to signal when a block is ready. */
+  Thread *writer;
+  /*! Set while armed, no blocks are written to file. */
+  volatile bool hold;
+  /*! Block the writer is writing, which must not be overwritten, or -1. */
+  volatile int writing;
+
+  /*! us_ticker time of the last record, used to decimate. */
+  uint32_t last_record_us;
+  /*! Set on a change of state, so the next record is taken straight away. */
+  volatile bool state_changed;
+
+  volatile uint32_t sequence;
+  volatile uint32_t blocks_written;
+  /*! Blocks dropped because the writer had not finished the next buffer. */
+  volatile uint32_t lost_blocks;
+  /*! Blocks dropped because the file could not be written. */
+  volatile uint32_t write_errors;
+  /*! Blocks dropped on purpose, while the flight log task was stopped or
+      without a file. */
+  volatile uint32_t discarded_blocks;
+} flight_log_t;
+
+/**
+* @brief Reset buffers and counters.
+* @param [out] log Flight log to initialise.
+*/
+void flight_log_init(flight_log_t *log);
+
+/**
+* @brief Copy a record into the current block. Never blocks.
+* @param [in/out] log Flight log.
+* @param [in] record Record to append.
+* @details When the current block fills, it is handed to the writer thread and
+*   the control loop moves onto the next block. If the writer has not yet
+*   flushed the next block, that older block is overwritten and counted as
+*   lost, unless it is being written, when the full block is dropped instead.
+*/
+void flight_log_append(flight_log_t *log, const flight_log_record_t *record);
+
+/**
+* @brief Hold or release writing to file. Safe to call from an ISR.
+* @details Held while the robot is armed, as a semihosted write would stop the
+*          CPU. Releasing wakes the writer to write whatever was kept.
+* @param [in/out] log Flight log.
+* @param [in] hold True to keep blocks in RAM.
+*/
+void flight_log_hold(flight_log_t *log, bool hold);
+
+/**
+* @brief Write any ready blocks to file. Called from the writer thread.
+* @details Stops at the next block if writing is held part way through.
+* @param [in/out] log Flight log.
+* @param [in] file Open log file, or NULL to discard.
+*/
+void flight_log_flush(flight_log_t *log, FILE *file);
+
+#endif //TC_FLIGHT_LOG_H
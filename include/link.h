@@ -0,0 +1,168 @@
+/* Copyright (c) 2018 Cameron A. Craig, MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ * BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * @file link.h
+ * @author Cameron A. Craig
+ * @date 17 Feb 2018
+ * @copyright 2018 Cameron A. Craig
+ * @brief Framed binary command links (e.g. ESP8266) and the command response routing.
+ */
+
+#ifndef TC_LINK_H
+#define TC_LINK_H
+
+#include "mbed.h"
+#include <stdint.h>
+#include "command.h"
+#include "thread_args.h"
+
+/* Every frame starts with this byte. */
+#define LINK_SYNC 0xA5
+
+/* Largest payload carried by a single frame. */
+#define LINK_MAX_PAYLOAD 64
+
+/* Bytes used by each parameter in a get or getall response. */
+#define LINK_PARAM_SIZE 6
+
+/**
+ * Parser states, one per field of a frame:
+ *   [LINK_SYNC][len][payload (len bytes)][crc8 of len and payload]
+ */
+typedef enum {
+  LINK_WAIT_SYNC = 0,
+  LINK_WAIT_LEN,
+  LINK_WAIT_PAYLOAD,
+  LINK_WAIT_CRC
+} link_parser_state_t;
+
+/**
+ * Incremental frame parser, fed one byte at a time (safe to use from an ISR).
+ */
+typedef struct {
+  link_parser_state_t state;
+  uint8_t len;
+  uint8_t pos;
+  uint8_t crc;
+  uint8_t payload[LINK_MAX_PAYLOAD];
+} link_parser_t;
+
+/**
+ * Frame counters for a link.
+ */
+typedef struct {
+  volatile uint32_t frames;
+  volatile uint32_t crc_errors;
+  /*! Valid frames that could not be decoded or queued. */
+  volatile uint32_t dropped;
+} link_stats_t;
+
+/**
+* @brief Reset parser to wait for the start of a frame.
+*/
+void link_parser_reset(link_parser_t *parser);
+
+/**
+* @brief Feed one received byte into the parser.
+* @return True when a complete frame with a valid CRC is in parser->payload.
+*/
+bool link_parser_feed(link_parser_t *parser, uint8_t byte);
+
+/**
+* @brief Update a CRC-8 (polynomial 0x07) with one byte.
+*/
+uint8_t link_crc8(uint8_t crc, uint8_t byte);
+
+/**
+* @brief Frame and write a payload.
+* @param [in] serial Serial port to write to.
+* @param [in] payload Bytes to send.
+* @param [in] len Number of bytes, at most LINK_MAX_PAYLOAD.
+*/
+void link_send_frame(RawSerial *serial, const uint8_t *payload, uint8_t len);
+
+/**
+* @brief Populate a command from a request payload.
+* @details Request: [seq][command_id_t][tele_command_id_t][value (4 bytes, LE)]
+*          The parameter and value are only present for get and set.
+*          getall instead carries [parameter mask (8 bytes, LE)], where bit n
+*          selects tele_command_id_t n, task carries
+*          [task_op_t][task ID][rate in Hz (2 bytes, LE, rate only)] and cfg
+*          carries [config_op_t][setting_id_t][value (4 bytes, LE, set only)].
+* @return RET_OK if the payload describes a command, RET_ERROR otherwise.
+*/
+int link_decode_command(const uint8_t *payload, uint8_t len, command_t *command);
+
+/**
+* @brief Write one parameter of a response.
+* @details [tele_command_id_t or setting_id_t][tele_command_type_t][value (4 bytes, LE)]
+* @return LINK_PARAM_SIZE, the number of bytes written to out.
+*/
+uint8_t link_encode_param(uint8_t id, tele_command_type_t type, const tele_value_t *value, uint8_t *out);
+
+/**
+* @brief Build a response payload for an executed command.
+* @details Response: [seq][return_codes_t]
+*          A successful get or cfg get also carries one value (link_encode_param()).
+* @return Length of the payload written to payload.
+*/
+uint8_t link_encode_response(const command_t *command, int err, uint8_t *payload);
+
+/**
+* @brief Send the response frame(s) for an executed command.
+* @details A successful getall is split over as many frames as needed, each
+*          starting [seq][return_codes_t] and followed by whole parameters in
+*          ID order. The caller must hold the serial port.
+* @param [in] serial Serial port to write to.
+* @param [in] command The executed command.
+* @param [in] err Return code from command_execute().
+* @param [in] targs Provides the telemetry mutex for reading parameters.
+*/
+void link_send_response(RawSerial *serial, const command_t *command, int err, thread_args_t *targs);
+
+/**
+* @brief Attach the ESP8266 RX interrupt, which queues commands received
+*        from the telemetry client with command_submit().
+*/
+void link_esp8266_init(thread_args_t *targs);
+
+/**
+* @return Frame counters for the ESP8266 link.
+*/
+const link_stats_t * link_esp8266_stats(void);
+
+/**
+* @brief Allow binary requests on the USB port to be queued with
+*        command_submit().
+*/
+void link_usb_init(thread_args_t *targs);
+
+/**
+* @brief Offer a byte received on the USB port to the binary frame parser.
+* @details A frame starts with LINK_SYNC, which can't be typed into the
+*          command line, so text and frames can share the port. Runs in
+*          interrupt context.
+* @return True if the byte was part of a frame, false if it is text.
+*/
+bool link_usb_feed(uint8_t byte);
+
+/**
+* @return Frame counters for the USB binary link.
+*/
+const link_stats_t * link_usb_stats(void);
+
+#endif //TC_LINK_H
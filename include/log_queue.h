@@ -0,0 +1,121 @@
+/* Copyright (c) 2018 Cameron A. Craig, MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ * BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * @file log_queue.h
+ * @author Cameron A. Craig
+ * @date 19 Mar 2018
+ * @copyright 2018 Cameron A. Craig
+ * @brief Defers formatting and output of log messages to a low priority thread,
+ *        which writes them out one whole message at a time, most urgent first.
+ */
+
+#ifndef TC_LOG_QUEUE_H
+#define TC_LOG_QUEUE_H
+
+#include <stdarg.h>
+#include <stdint.h>
+#include "mbed.h"
+#include "rtos.h"
+#include "config.h"
+
+/* Thread signal that wakes the log writer */
+#define LOG_QUEUE_SIGNAL 0x01
+
+/* Argument words stored with each message, a double takes two */
+#define LOG_QUEUE_MAX_ARG_WORDS 12
+
+/**
+ * Output channels, each with its own queue. Waiting messages are written
+ * out from the first channel that has any.
+ */
+typedef enum {
+  /*! Errors and warnings. */
+  LOG_CHANNEL_ALERT = 0,
+  /*! Command replies and other console output. */
+  LOG_CHANNEL_CONSOLE,
+  /*! Information and debug messages from tasks. */
+  LOG_CHANNEL_DEBUG,
+  NUM_LOG_CHANNELS
+} log_channel_t;
+
+/**
+ * Counters kept by the log queue.
+ */
+typedef struct {
+  /*! Messages formatted and written out. */
+  uint32_t written;
+  /*! Messages dropped because their channel's queue was full. */
+  uint32_t dropped[NUM_LOG_CHANNELS];
+  /*! Messages cut short, because they had too many arguments or were too
+      long to format. */
+  uint32_t truncated;
+} log_queue_stats_t;
+
+/**
+* @brief Set the thread that formats and writes out queued messages.
+* @param [in] writer Thread to signal when messages are queued.
+*/
+void log_queue_init(Thread *writer);
+
+/**
+* @brief Queue a message without formatting it. Never blocks, so it is safe
+*        from any thread or ISR.
+* @details Only the format pointer and the raw argument values are stored,
+*          so the format and any %s arguments must still be valid when the
+*          writer gets to the message, e.g. string literals or names from
+*          constant tables.
+* @param [in] channel Channel to queue the message on.
+* @param [in] format printf() style format.
+* @return RET_OK, or RET_ERROR if the queue was full and the message dropped.
+*/
+int log_queue_write(log_channel_t channel, const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+/**
+* @brief As log_queue_write() on the console channel, but waits for room in
+*        the queue rather than dropping the message, unless called from an ISR.
+* @details For console output such as command replies, where a long listing
+*          would otherwise overrun the queue.
+* @param [in] format printf() style format.
+*/
+void log_queue_print(const char *format, ...) __attribute__((format(printf, 1, 2)));
+
+/**
+* @brief Format and write out every queued message, oldest first.
+* @details Only one thread may flush.
+* @param [in] serial Port to write to.
+*/
+void log_queue_flush(RawSerial *serial);
+
+/**
+* @brief Wait until messages are queued, or timeout_ms passes.
+* @param [in] timeout_ms Longest time to wait.
+*/
+void log_queue_wait(uint32_t timeout_ms);
+
+/**
+* @brief Wake the writer for output queued outside the log queue, such as
+*        the command line echo. Safe from any thread or ISR.
+*/
+void log_queue_wake(void);
+
+/**
+* @brief Copy the queue counters.
+* @param [out] stats Counters.
+*/
+void log_queue_get_stats(log_queue_stats_t *stats);
+
+#endif  // TC_LOG_QUEUE_H
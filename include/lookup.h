@@ -0,0 +1,74 @@
+/* Copyright (c) 2018 Cameron A. Craig, MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ * BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * @file lookup.h
+ * @author Cameron A. Craig
+ * @date 3 Mar 2018
+ * @copyright 2018 Cameron A. Craig
+ * @brief Perfect hash tables for O(1) exact name lookups.
+ */
+
+#ifndef TC_LOOKUP_H
+#define TC_LOOKUP_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* Largest table, must be a power of two and fit an index in a slot. */
+#define LOOKUP_MAX_SLOTS 128
+
+/* Seeds to try before giving up and falling back to a linear search. */
+#define LOOKUP_MAX_SEEDS 10000
+
+/**
+ * Maps names onto indices of a fixed array of entries. The seed is chosen
+ * when the table is built so that no two names share a slot, so a lookup is
+ * one hash and one string compare.
+ */
+typedef struct {
+  /*! Returns the name of entry index. */
+  const char * (*name)(unsigned index);
+  unsigned count;
+  uint32_t seed;
+  /*! Number of slots in use, a power of two. */
+  uint32_t size;
+  /*! True if a collision free seed was found. */
+  bool perfect;
+  /*! Entry index + 1 for each slot, 0 if empty. */
+  uint8_t slots[LOOKUP_MAX_SLOTS];
+} lookup_table_t;
+
+/**
+* @brief Find a seed that maps every name to its own slot.
+* @param [out] table Table to build.
+* @param [in] name Returns the name of an entry.
+* @param [in] count Number of entries (less than LOOKUP_MAX_SLOTS).
+* @return True if a perfect hash was found, otherwise lookups fall back to
+*         a linear search.
+*/
+bool lookup_build(lookup_table_t *table, const char * (*name)(unsigned index), unsigned count);
+
+/**
+* @brief Find the entry whose name exactly matches key.
+* @param [in] table Table to search.
+* @param [in] key Name to look for (need not be null terminated).
+* @param [in] len Length of key.
+* @return Index of the entry, or -1 if there is no match.
+*/
+int lookup_find(const lookup_table_t *table, const char *key, size_t len);
+
+#endif //TC_LOOKUP_H
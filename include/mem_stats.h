@@ -0,0 +1,72 @@
+/* Copyright (c) 2018 Cameron A. Craig, MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ * BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * @file mem_stats.h
+ * @author Cameron A. Craig
+ * @date 12 Mar 2018
+ * @copyright 2018 Cameron A. Craig
+ * @brief Heap and stack usage, sampled for the mem command and telemetry.
+ */
+
+#ifndef TC_MEM_STATS_H
+#define TC_MEM_STATS_H
+
+#include <stdint.h>
+#include "thread_args.h"
+
+/**
+ * Memory usage at the last sample, all sizes in bytes.
+ */
+typedef struct {
+  /*! Heap currently allocated, and the most ever allocated. */
+  uint32_t heap_current;
+  uint32_t heap_peak;
+  /*! Space set aside for the heap. */
+  uint32_t heap_reserved;
+  /*! Allocations not yet freed, and allocations that have failed. */
+  uint32_t alloc_count;
+  uint32_t alloc_failures;
+
+  /*! Stack used by interrupt handlers (and main() before the RTOS starts). */
+  uint32_t isr_stack_size;
+  uint32_t isr_stack_peak;
+
+  /*! Stack of the task using the largest share of its stack. */
+  uint32_t task_stack_peak_id;
+  uint32_t task_stack_peak_percent;
+} mem_stats_t;
+
+/**
+* @brief Fill the unused part of the ISR stack so its high water mark can be
+*        measured, call once early in main().
+*/
+void mem_stats_init(void);
+
+/**
+* @brief Take a new sample of heap and stack usage.
+* @details Cheap enough to call every second: it reads the heap counters and
+*          scans only the ISR stack for its fill pattern. Task stack peaks are
+*          taken from task_stack_sample().
+*/
+void mem_stats_sample(thread_args_t *targs);
+
+/**
+* @brief Copy the most recent sample.
+*/
+void mem_stats_get(mem_stats_t *stats);
+
+#endif  // TC_MEM_STATS_H
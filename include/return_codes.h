@@ -32,7 +32,11 @@ enum return_codes_t {
   RET_OK,
   RET_ALREADY_DISARMED,
   RET_ALREADY_ARMED,
-  RET_DISARM_FIRST
+  RET_DISARM_FIRST,
+  RET_READ_ONLY,
+  RET_NOT_ALLOWED,
+  RET_OUT_OF_RANGE,
+  RET_CONFLICT
 };
 
 static const char * ret_str[] = {
@@ -40,7 +44,11 @@ static const char * ret_str[] = {
   "Ok",
   "Already disarmed",
   "Already armed",
-  "Disarm before running this command"
+  "Disarm before running this command",
+  "Parameter is read only",
+  "Command not allowed on this link",
+  "Value out of range",
+  "Value conflicts with another setting"
 };
 
 /**
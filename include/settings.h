@@ -0,0 +1,212 @@
+/* Copyright (c) 2018 Cameron A. Craig, MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ * BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * @file settings.h
+ * @author Cameron A. Craig
+ * @date 8 Mar 2018
+ * @copyright 2018 Cameron A. Craig
+ * @brief Tunable parameters that can be changed at run time.
+ */
+
+#ifndef TC_SETTINGS_H
+#define TC_SETTINGS_H
+
+#include <stddef.h>
+#include "config.h"
+#include "types.h"
+#include "drive_mode.h"
+#include "tele_param.h"
+
+/**
+ * All run time settings. The control loop takes a copy with settings_read()
+ * once per iteration, so every setting it uses comes from the same update.
+ */
+typedef struct {
+  int drive_mode;
+  int weapon_mode;
+
+  /*! Switch channel position above which a switch is on (%). */
+  float switch_midpoint;
+  /*! Stick window that counts as centred when arming (%). */
+  float stick_centre_min;
+  float stick_centre_max;
+  /*! Throttle must be at or below this to arm (%), kept small so the
+      throttle low interlock cannot be turned off. */
+  float throttle_arm_max;
+  /*! Time without a receiver pulse before a receiver is considered lost. */
+  int stall_timeout_ms;
+
+  int heading_lock_speed;
+  int heading_lock_deadband;
+
+  /*! Weapon RPM at full throttle stick, in RPM hold mode. */
+  int weapon_rpm_max;
+  /*! Throttle (%) per 1000 RPM of error. */
+  float weapon_rpm_kp;
+  /*! Throttle (%) per 1000 RPM of error, per second. */
+  float weapon_rpm_ki;
+  /*! Fastest change of the target RPM (RPM per second). */
+  int weapon_rpm_ramp;
+  /*! Below this the weapon is spun up open loop, as the tachometer may not
+      be reliable (e.g. sensorless motors). */
+  int weapon_spinup_rpm;
+
+  /*! Pulse width range of each receiver channel (us), see calibrate. */
+  channel_limits_t channel_limits[RC_NUMBER_CONTROLLERS][RC_NUMBER_CHANNELS];
+} settings_t;
+
+/* Channel limits, one min and max setting per receiver channel */
+#define SETTINGS_CHANNEL(X, rc, ch) \
+  X(SETTING_RC##rc##_CH##ch##_MIN, "rc" #rc "_ch" #ch "_min", CT_FLOAT, channel_limits[rc][ch - 1].min, RC_##rc##_CHAN_##ch##_MIN, 500, 2500) \
+  X(SETTING_RC##rc##_CH##ch##_MAX, "rc" #rc "_ch" #ch "_max", CT_FLOAT, channel_limits[rc][ch - 1].max, RC_##rc##_CHAN_##ch##_MAX, 500, 2500)
+
+#define SETTINGS_RECEIVER(X, rc) \
+  SETTINGS_CHANNEL(X, rc, 1) \
+  SETTINGS_CHANNEL(X, rc, 2) \
+  SETTINGS_CHANNEL(X, rc, 3) \
+  SETTINGS_CHANNEL(X, rc, 4) \
+  SETTINGS_CHANNEL(X, rc, 5) \
+  SETTINGS_CHANNEL(X, rc, 6)
+
+/**
+ * Every run time setting. To add a setting, add a field to settings_t and
+ * one row here. Rules between settings are in settings_validate().
+ *
+ * X(id, name, type, field, default, min, max)
+ */
+#define SETTINGS(X) \
+  X(SETTING_DRIVE_MODE,            "drive_mode",       CT_INT,   drive_mode,            DM_2_WHEEL_DIFFERENTIAL, DM_3_WHEEL_HOLONOMIC, DM_2_WHEEL_DIFFERENTIAL) \
+  X(SETTING_WEAPON_MODE,           "weapon_mode",      CT_INT,   weapon_mode,           WM_MANUAL_THROTTLE,      WM_MANUAL_THROTTLE,   WM_RPM_HOLD)             \
+  X(SETTING_SWITCH_MIDPOINT,       "switch_mid",       CT_FLOAT, switch_midpoint,       RC_SWITCH_MIDPOINT,      0,                    100)                     \
+  X(SETTING_STICK_CENTRE_MIN,      "stick_centre_min", CT_FLOAT, stick_centre_min,      45,                      0,                    100)                     \
+  X(SETTING_STICK_CENTRE_MAX,      "stick_centre_max", CT_FLOAT, stick_centre_max,      55,                      0,                    100)                     \
+  X(SETTING_THROTTLE_ARM_MAX,      "throttle_arm_max", CT_FLOAT, throttle_arm_max,      2,                       0,                    10)                      \
+  X(SETTING_STALL_TIMEOUT_MS,      "stall_timeout",    CT_INT,   stall_timeout_ms,      200,                     20,                   2000)                    \
+  X(SETTING_HEADING_LOCK_SPEED,    "hl_speed",         CT_INT,   heading_lock_speed,    50,                      0,                    100)                     \
+  X(SETTING_HEADING_LOCK_DEADBAND, "hl_deadband",      CT_INT,   heading_lock_deadband, 5,                       0,                    45)                      \
+  X(SETTING_WEAPON_RPM_MAX,        "weapon_rpm_max",   CT_INT,   weapon_rpm_max,        8000,                    500,                  30000)                   \
+  X(SETTING_WEAPON_RPM_KP,         "weapon_rpm_kp",    CT_FLOAT, weapon_rpm_kp,         10,                      0,                    50)                      \
+  X(SETTING_WEAPON_RPM_KI,         "weapon_rpm_ki",    CT_FLOAT, weapon_rpm_ki,         40,                      0,                    50)                      \
+  X(SETTING_WEAPON_RPM_RAMP,       "weapon_rpm_ramp",  CT_INT,   weapon_rpm_ramp,       10000,                   100,                  100000)                  \
+  X(SETTING_WEAPON_SPINUP_RPM,     "weapon_spinup",    CT_INT,   weapon_spinup_rpm,     1000,                    100,                  30000)                   \
+  SETTINGS_RECEIVER(X, 0) \
+  SETTINGS_RECEIVER(X, 1)
+
+#define SETTING_ENUM_ENTRY(id, name, type, field, def, min, max) id,
+
+/**
+ * Setting IDs, also the index of each setting in the registry.
+ */
+typedef enum {
+  SETTINGS(SETTING_ENUM_ENTRY)
+  SETTING_COUNT
+} setting_id_t;
+
+#define NUM_SETTINGS ((unsigned) SETTING_COUNT)
+
+/**
+ * Describes one setting.
+ */
+typedef struct {
+  setting_id_t id;
+  const char *name;
+  tele_command_type_t type;
+  /*! Position of the value within settings_t. */
+  size_t offset;
+  float def;
+  float min;
+  float max;
+} setting_t;
+
+/**
+* @brief Load the defaults and build the name lookup table.
+* @return True if a perfect hash was found for the setting names.
+*/
+bool settings_init(void);
+
+/**
+* @brief Take a consistent copy of all settings, without locking.
+* @details Never blocks, so is safe to call from the control loop.
+*/
+void settings_read(settings_t *settings);
+
+/**
+* @param [in] id Setting ID.
+* @return The setting, or NULL if id is out of range.
+*/
+const setting_t * setting_get(unsigned id);
+
+/**
+* @brief Find a setting by name.
+* @param [in] name Name of the setting (need not be null terminated).
+* @param [in] len Length of name.
+* @return The setting, or NULL if there is no setting called name.
+*/
+const setting_t * setting_find(const char *name, size_t len);
+
+/**
+* @brief Read the current value of one setting.
+*/
+void setting_value(const setting_t *setting, tele_value_t *value);
+
+/**
+* @brief Check whether a setting may only be changed while disarmed.
+* @details The drive and weapon modes change what the sticks do, so are
+*          never switched under the driver's hands.
+*/
+bool setting_needs_disarm(const setting_t *setting);
+
+/**
+* @brief Validate and publish a new value for one setting.
+* @return RET_OK, RET_OUT_OF_RANGE if value is outside [min, max] or
+*         RET_CONFLICT if it breaks a rule in settings_validate().
+*/
+int setting_set(const setting_t *setting, const tele_value_t *value);
+
+/**
+* @brief Check a whole set of settings, both each value against its range
+*        and the rules between settings.
+* @details A stick centre window must not be empty and each channel's min
+*          must be below its max (read_recv_pw() divides by the difference).
+*          The spin-up RPM must be below the RPM at full stick.
+* @return RET_OK, RET_OUT_OF_RANGE or RET_CONFLICT.
+*/
+int settings_validate(const settings_t *settings);
+
+/**
+* @brief Start changing several settings at once.
+* @details Returns a private copy of the current settings to modify. Nothing
+*          is visible to readers until settings_edit_commit(). Must be
+*          followed by settings_edit_commit(), from the same thread.
+*/
+settings_t * settings_edit_begin(void);
+
+/**
+* @brief Publish the changes made since settings_edit_begin().
+* @details Also saves the settings for a warm restart. If the changes fail
+*          settings_validate() they are all thrown away.
+* @return RET_OK, or the result of settings_validate().
+*/
+int settings_edit_commit(void);
+
+/**
+* @brief Replace all settings at once, e.g. with those saved before a reset.
+* @return RET_OK, or the result of settings_validate() if they were refused.
+*/
+int settings_restore(const settings_t *settings);
+
+#endif //TC_SETTINGS_H
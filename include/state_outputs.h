@@ -0,0 +1,65 @@
+/* Copyright (c) 2018 Cameron A. Craig, MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ * BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * @file state_outputs.h
+ * @author Cameron A. Craig
+ * @date 21 Mar 2018
+ * @copyright 2018 Cameron A. Craig
+ * @brief Everything that follows the arming state, told of each change rather than polling it.
+ */
+
+#ifndef TC_STATE_OUTPUTS_H
+#define TC_STATE_OUTPUTS_H
+
+#include "thread_args.h"
+#include "comms.h"
+
+/* ESC gate bits, bit n for ESC output n (COMMS_OUTPUT_*) */
+#define ESC_GATE_DRIVE  ((1U << COMMS_OUTPUT_DRIVE_1) | (1U << COMMS_OUTPUT_DRIVE_2) | (1U << COMMS_OUTPUT_DRIVE_3))
+#define ESC_GATE_WEAPON ((1U << COMMS_OUTPUT_WEAPON_1) | (1U << COMMS_OUTPUT_WEAPON_2) | (1U << COMMS_OUTPUT_WEAPON_3))
+
+/**
+* @brief Subscribe the ESC gate, LEDs, telemetry and flight log to the arming
+*        state, and bring each of them up to date with the current state.
+* @details Call once during boot, after the LEDs and ESCs are initialised.
+* @param [in/out] args Thread arguments.
+*/
+void state_outputs_init(thread_args_t *args);
+
+/**
+* @brief ESC outputs that may be driven in a state.
+* @return ESC_GATE_* bits.
+*/
+uint32_t esc_gate_for_state(state_t state);
+
+/**
+* @brief Stop some of the ESCs.
+* @param [in/out] args Thread arguments.
+* @param [in] outputs ESC_GATE_* bits of the ESCs to stop.
+*/
+void esc_gate_stop(thread_args_t *args, uint32_t outputs);
+
+/**
+* @brief Close the ESC gate until the next reset, without changing the state.
+* @details For the supervisor, once the watchdog is going to reset. The state
+*          (and so the state warm_start_save_control() saves) is left as it
+*          was, see warm_start.h.
+* @param [in/out] args Thread arguments.
+*/
+void esc_gate_shut(thread_args_t *args);
+
+#endif //TC_STATE_OUTPUTS_H
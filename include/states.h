@@ -25,16 +25,120 @@
 #ifndef TC_STATES_T
 #define TC_STATES_T
 
+#include <stdint.h>
+
 enum state_t {
   STATE_DISARMED = 0,
   STATE_DRIVE_ONLY,
   STATE_WEAPON_ONLY,
-  STATE_FULLY_ARMED
+  STATE_FULLY_ARMED,
+  NUM_STATES
 };
 
+/* The state is swapped as a 32 bit word, see state_raise() */
+typedef char state_t_is_a_word[(sizeof(state_t) == sizeof(uint32_t)) ? 1 : -1];
+
+/**
+ * Everything that can change the arming state. What each event does in each
+ * state is set by one table in states.cpp.
+ */
+enum state_event_t {
+  /*! Drive arm switch is off. */
+  STATE_EVENT_DRIVE_SWITCH_OFF = 0,
+  /*! Weapon arm switch is off. */
+  STATE_EVENT_WEAPON_SWITCH_OFF,
+  /*! Drive arm switch is on, with the sticks centred and throttle low. */
+  STATE_EVENT_DRIVE_READY,
+  /*! Weapon arm switch is on, with the sticks centred and throttle low. */
+  STATE_EVENT_WEAPON_READY,
+  /*! Drive transmitter has stopped sending. */
+  STATE_EVENT_DRIVE_STALL,
+  /*! Weapon transmitter has stopped sending. */
+  STATE_EVENT_WEAPON_STALL,
+  /*! Fully disarm command. */
+  STATE_EVENT_COMMAND_DISARM,
+  /*! Partial disarm command. */
+  STATE_EVENT_COMMAND_PARTIAL_DISARM,
+  /*! Partial arm command. */
+  STATE_EVENT_COMMAND_PARTIAL_ARM,
+  /*! Fully arm command. */
+  STATE_EVENT_COMMAND_ARM,
+  /*! Drive was armed before a watchdog reset. */
+  STATE_EVENT_WATCHDOG_DRIVE,
+  /*! Weapon was armed before a watchdog reset. */
+  STATE_EVENT_WATCHDOG_WEAPON,
+  NUM_STATE_EVENTS
+};
+
+/**
+ * A change of state, as recorded by state_raise().
+ */
+typedef struct {
+  /*! Time of the change (ms since reset). */
+  uint32_t time_ms;
+  /*! Event that caused it. */
+  state_event_t event;
+  state_t from;
+  state_t to;
+} state_transition_t;
+
+/**
+* @brief Called with each change of state, see state_subscribe().
+* @param [in] context As passed to state_subscribe().
+* @param [in] transition The change.
+*/
+typedef void (*state_subscriber_t)(void *context, const state_transition_t *transition);
+
 /**
 * @brief Return meaningful string name of state.
 */
 const char * state_to_str(state_t state);
 
+/**
+* @brief Return meaningful string name of event.
+*/
+const char * state_event_to_str(state_event_t event);
+
+/**
+* @brief Apply an event to the arming state.
+* @details This is the only place the state changes after boot. The new state
+*          is looked up from the current one and swapped in atomically, so
+*          events raised at the same time by different tasks, commands or
+*          ISRs are applied one after another and none are lost. Each change
+*          is recorded with its time and cause, then delivered to every
+*          subscriber before this returns.
+* @param [in/out] state State to change (thread_args_t::state).
+* @param [in] event What happened.
+* @return true if the state changed, false if the event has no effect in the
+*         current state.
+*/
+bool state_raise(volatile state_t *state, state_event_t event);
+
+/**
+* @brief Deliver every future change of state to a subscriber.
+* @details Subscribers are called in the context that raised the event, which
+*          may be any task or an ISR, so they must be short and must not
+*          block. Two changes raised at the same moment may be delivered out
+*          of order, so a subscriber that acts on the state should read the
+*          state again rather than rely on transition->to. Subscribe during
+*          boot, before any task can raise an event.
+* @param [in] subscriber Function to call.
+* @param [in] context Passed to subscriber.
+* @return RET_OK, or RET_ERROR if STATE_MAX_SUBSCRIBERS are subscribed already.
+*/
+int state_subscribe(state_subscriber_t subscriber, void *context);
+
+/**
+* @brief Copy the most recent state changes, newest first.
+* @param [out] history Array to copy into.
+* @param [in] len Size of history.
+* @return Number of changes copied, at most STATE_HISTORY_LEN.
+*/
+unsigned state_history(state_transition_t *history, unsigned len);
+
+/**
+* @brief Total number of state changes since reset.
+*/
+uint32_t state_transitions(void);
+
 #endif //TC_STATES_T
@@ -28,6 +28,33 @@
 #include "mbed.h"
 #include <stdint.h>
 
+/**
+ * Run time statistics, updated by the task and read by "task list".
+ */
+typedef struct {
+  /*! Iterations since the statistics were last taken. */
+  volatile uint32_t iterations;
+  /*! CPU cycles spent in those iterations. */
+  volatile uint32_t busy_cycles;
+  /*! Longest single iteration in CPU cycles. */
+  volatile uint32_t max_cycles;
+  /*! us_ticker_read() at the start of the most recent iteration. */
+  volatile uint32_t last_run_us;
+  volatile bool has_run;
+
+  /* The following are kept for the life of the task. */
+
+  /*! When the current iteration became due (us_ticker_read()). */
+  volatile uint32_t release_us;
+  volatile bool released;
+  /*! Iterations that finished after their deadline. */
+  volatile uint32_t deadline_misses;
+  /*! Longest time from release to the end of an iteration. */
+  volatile uint32_t worst_response_us;
+  /*! Longest time from release to the start of an iteration. */
+  volatile uint32_t worst_jitter_us;
+} task_stats_t;
+
 /**
  * Stores task parameters.
  */
@@ -35,10 +62,25 @@ typedef struct {
   uint32_t id;
   const char *name;
   void (*func)(const void*);
+  /*! Run every period_ms on the event queue instead of on a thread of its
+      own (func is then NULL), see task_events(). */
+  void (*step)(const void*);
   void * args;
+  /*! Replaced at start up for periodic tasks, see task_assign_priorities(). */
   osPriority priority;
   uint32_t stack_size;
+  /*! Statically allocated stack of stack_size bytes. */
+  unsigned char *stack_mem;
+  /*! Time between iterations, 0 if the task waits on an event instead. */
+  volatile uint32_t period_ms;
+  /*! Each iteration must finish this long after it is due, 0 for period_ms. */
+  uint32_t deadline_ms;
+  /*! Longest the supervisor will wait between iterations, 0 if unsupervised. */
+  uint32_t heartbeat_ms;
   volatile bool active;
+  task_stats_t stats;
+  /*! Most stack the task has been seen to use, in bytes. */
+  volatile uint32_t stack_peak;
 } task_t;
 
 #endif  // INCLUDE_TASK_H_
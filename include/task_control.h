@@ -0,0 +1,168 @@
+/* Copyright (c) 2018 Cameron A. Craig, MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ * BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * @file task_control.h
+ * @author Cameron A. Craig
+ * @date 5 Mar 2018
+ * @copyright 2018 Cameron A. Craig
+ * @brief Run time task statistics and control.
+ */
+
+#ifndef INCLUDE_TASK_CONTROL_H_
+#define INCLUDE_TASK_CONTROL_H_
+
+#include <stddef.h>
+#include "task.h"
+#include "thread_args.h"
+
+/* Thread signal that wakes a parked task, kept clear of the low bits that
+   tasks use for their own events (e.g. FLIGHT_LOG_SIGNAL). The pinned mbed
+   OS runs RTX5, the same signals as the rest of the tree are used rather
+   than EventFlags. */
+#define TASK_WAKE_SIGNAL 0x4000
+
+/* Lowest priority given to a periodic task. Periodic tasks share the levels
+   between here and osPriorityHigh, leaving osPriorityHigh and above for
+   safety commands and the levels below for tasks woken by events. RTX5
+   (CMSIS-RTOS2) has the osPriorityNormal1..7 and AboveNormal..AboveNormal7
+   levels in between, RTX4 would have only one. */
+#define TASK_PRIORITY_PERIODIC_MIN (osPriorityNormal + 1)
+
+/**
+* @brief Start the CPU cycle counter used to time task iterations.
+*/
+void task_control_init(void);
+
+/**
+* @brief Number of times RTX has switched the running thread since boot.
+* @details Counted by the RTX5 thread switch event hook, so it stays at 0 if
+*          the RTX event recorder hooks are compiled out of mbed OS.
+*/
+uint32_t task_context_switches(void);
+
+/**
+* @brief Mark the start of one iteration of a task.
+* @param [in/out] task The task being run.
+* @return Cycle count to pass to task_iteration_end().
+*/
+uint32_t task_iteration_begin(task_t *task);
+
+/**
+* @brief Mark a task as due, for tasks released by something other than
+*        task_sleep() (e.g. a timer interrupt).
+* @param [in/out] task The task being released.
+* @param [in] release_us us_ticker_read() when the iteration became due.
+*/
+void task_release(task_t *task, uint32_t release_us);
+
+/**
+* @brief Mark the end of one iteration of a task, updating its statistics.
+* @details Also sets the task's heartbeat bit for the supervisor.
+* @param [in/out] task The task being run.
+* @param [in] start_cycles Value returned by task_iteration_begin().
+*/
+void task_iteration_end(task_t *task, uint32_t start_cycles);
+
+/**
+* @brief Read and clear the heartbeat bits set since the last call.
+* @return Bit n is set if task n finished an iteration.
+*/
+uint32_t task_heartbeats_take(void);
+
+/**
+* @brief Sleep until the next iteration of a periodic task is due.
+* @details Uses the period set by "task rate", so it can be changed live.
+*          Iterations are released every period_ms regardless of how long
+*          each one takes. A stopped task is parked until it is started again.
+*/
+void task_sleep(task_t *task);
+
+/**
+* @brief Block the calling task, using no CPU, until it is made active.
+*/
+void task_park(task_t *task);
+
+/**
+* @brief Give periodic tasks priorities in order of their deadlines.
+* @details The shortest deadline gets the highest priority (rate monotonic
+*          when the deadline is the period). Tasks with equal deadlines share
+*          a priority. Tasks woken by events, and background tasks given a
+*          priority below osPriorityNormal, keep the priority in their entry.
+* @param [in/out] tasks Task table.
+* @param [in] num_tasks Number of entries in tasks.
+*/
+void task_assign_priorities(task_t *tasks, unsigned num_tasks);
+
+/**
+* @brief Start or stop a task, waking it if it is parked.
+* @details Always use this rather than writing task_t::active directly, or a
+*          parked task will not notice that it has been started.
+*/
+void task_set_active(thread_args_t *targs, unsigned id, bool active);
+
+/**
+* @brief Copy a task's statistics and start collecting them afresh.
+* @param [in/out] task The task to read.
+* @param [out] stats Statistics collected since the last call. The deadline
+*              miss count and worst response time cover the life of the task.
+*/
+void task_stats_take(task_t *task, task_stats_t *stats);
+
+/**
+* @brief Record the stack high water mark of a task.
+* @return True if the task has used more stack than ever before.
+*/
+bool task_stack_sample(thread_args_t *targs, unsigned id);
+
+/**
+* @brief Stack size that covers the largest use seen, plus STACK_MARGIN_PERCENT.
+*/
+uint32_t task_stack_recommended(const task_t *task);
+
+/**
+* @brief Check whether a task has come within STACK_MARGIN_PERCENT of overflow.
+*/
+bool task_stack_low(const task_t *task);
+
+/**
+* @brief Find a task by name or ID.
+* @details Names are matched ignoring case, with '_' or '-' standing in for
+*          spaces, so "motor_drive" finds "Motor Drive".
+* @param [in] name Name or decimal ID (need not be null terminated).
+* @param [in] len Length of name.
+* @return Task ID, or -1 if there is no such task.
+*/
+int task_find(const char *name, size_t len);
+
+/**
+* @brief Check whether a task may be stopped at run time.
+* @details Stopping the tasks that read and run commands would leave no way
+*          to start them again, and the events task never parks. The motor
+*          drive task holds the ESC outputs, failsafe drops them when a
+*          receiver stalls and the supervisor kicks the watchdog.
+*/
+bool task_stoppable(unsigned id);
+
+/**
+* @brief Check whether a task decides what reaches the ESC outputs, so it may
+*        only be stopped or started while disarmed.
+* @details Arming is what disarms on the switches, orientation flips the
+*          drive and calibration rewrites the channel limits.
+*/
+bool task_gates_outputs(unsigned id);
+
+#endif  // INCLUDE_TASK_CONTROL_H_
@@ -23,13 +23,21 @@
  */
 
 #include "thread_args.h"
+#include "settings.h"
 
 /**
 * @brief Read PWM values from receiver.
+* @param [in] settings Provides the channel limits.
 */
-void read_recv_pw(thread_args_t *args);
+void read_recv_pw(thread_args_t *args, const settings_t *settings);
 
 /**
 * @brief Set value of output ESC using configured comms method.
 */
 void set_output_escs(thread_args_t *args);
+
+/**
+* @brief Append a snapshot of the control loop to the flight log.
+* @details Records are decimated to one per FLIGHT_LOG_PERIOD_MS.
+*/
+void log_flight_record(thread_args_t *args);
@@ -45,8 +45,16 @@ static const unsigned TASK_READ_SERIAL_ID = __COUNTER__;
 static const unsigned TASK_PROCESS_COMMANDS_ID = __COUNTER__;
 #endif
 
-#ifdef TASK_LED_STATE
-static const unsigned TASK_LED_STATE_ID = __COUNTER__;
+#ifdef TASK_SAFETY_COMMANDS
+static const unsigned TASK_SAFETY_COMMANDS_ID = __COUNTER__;
+#endif
+
+#ifdef TASK_EVENTS
+static const unsigned TASK_EVENTS_ID = __COUNTER__;
+#endif
+
+#ifdef TASK_EXECUTIVE
+static const unsigned TASK_EXECUTIVE_ID = __COUNTER__;
 #endif
 
 #ifdef TASK_MOTOR_DRIVE
@@ -77,12 +85,69 @@ static const unsigned TASK_STREAM_TELEMETRY_ID = __COUNTER__;
 static const unsigned TASK_CALIBRATE_CHANNELS_ID = __COUNTER__;
 #endif
 
+#ifdef TASK_FLIGHT_LOG
+static const unsigned TASK_FLIGHT_LOG_ID = __COUNTER__;
+#endif
+
+#ifdef TASK_STACK_MONITOR
+static const unsigned TASK_STACK_MONITOR_ID = __COUNTER__;
+#endif
+
+#ifdef TASK_SUPERVISOR
+static const unsigned TASK_SUPERVISOR_ID = __COUNTER__;
+#endif
+
+#ifdef TASK_LOG
+static const unsigned TASK_LOG_ID = __COUNTER__;
+#endif
+
 #ifdef TASK_DEBUG
 static const unsigned TASK_DEBUG_ID = __COUNTER__;
 #endif
 
 static const unsigned NUM_TASKS = __COUNTER__;
 
+/* Tasks with a period and a priority of at least osPriorityNormal, each of
+   which may need a priority level of its own, see task_assign_priorities() */
+static const unsigned NUM_PERIODIC_TASKS = 0
+#ifdef TASK_EXECUTIVE
+  + 1
+#endif
+#ifdef TASK_MOTOR_DRIVE
+  + 1
+#endif
+#ifdef TASK_ARMING
+  + 1
+#endif
+#ifdef TASK_FAILSAFE
+  + 1
+#endif
+#ifdef TASK_CALC_ORIENTATION
+  + 1
+#endif
+#ifdef TASK_COLLECT_TELEMETRY
+  + 1
+#endif
+#ifdef TASK_STREAM_TELEMETRY
+  + 1
+#endif
+#ifdef TASK_CALIBRATE_CHANNELS
+  + 1
+#endif
+#ifdef TASK_SUPERVISOR
+  + 1
+#endif
+#ifdef TASK_DEBUG
+  + 1
+#endif
+;
+
+/* These tasks have no thread of their own */
+#if !defined(TASK_EVENTS) && (defined(TASK_ARMING) || \
+  defined(TASK_COLLECT_TELEMETRY) || defined(TASK_CALIBRATE_CHANNELS))
+#error "TASK_EVENTS is needed to run the arming, telemetry and calibration tasks"
+#endif
+
 
 /* Function signatures */
 
@@ -96,80 +161,125 @@ void task_read_serial(const void *targs);
 void task_process_commands(const void *targs);
 #endif
 
-#ifdef TASK_LED_STATE
-void task_state_leds(const void *targs);
+#ifdef TASK_SAFETY_COMMANDS
+void task_safety_commands(const void *targs);
 #endif
 
-#ifdef TASK_MOTOR_DRIVE
-void task_motor_drive(const void *targs);
+#ifdef TASK_EVENTS
+void task_events(const void *targs);
+
+/**
+* @brief (Re)start a queued task on the event queue, e.g. after it has been
+*        started or its period changed. Safe to call from any thread.
+* @param [in] id ID of a task with a step function.
+*/
+void task_events_schedule(unsigned id);
 #endif
 
-#ifdef TASK_ARMING
-void task_arming(const void *targs);
+#ifdef TASK_EXECUTIVE
+void task_executive(const void *targs);
+
+/**
+* @brief Stop the executive running a slot, e.g. when its device is missing.
+* @param [in] step Step function of the slot.
+*/
+void task_executive_disable(void (*step)(const void *targs));
+#endif
+
+#ifdef TASK_MOTOR_DRIVE
+void task_motor_drive(const void *targs);
 #endif
 
 #ifdef TASK_FAILSAFE
 void task_failsafe(const void *targs);
 #endif
 
+/* One iteration of each control task, run by its own thread, the event
+   queue or the cyclic executive. */
+
+
+#if defined(TASK_MOTOR_DRIVE) || defined(TASK_EXECUTIVE)
+/**
+* @brief Read the receivers, run the drive and weapon modes and set the ESCs.
+* @param [in/out] targs Thread arguments.
+*/
+void task_motor_drive_step(const void *targs);
+#endif
+
+#if defined(TASK_ARMING) || defined(TASK_EXECUTIVE)
+/**
+* @brief Change the arming state based on the arming switches.
+* @param [in/out] targs Thread arguments.
+*/
+void task_arming_step(const void *targs);
+#endif
+
+#if defined(TASK_FAILSAFE) || defined(TASK_EXECUTIVE)
+/**
+* @brief Drop the arming state for any transmitter that has stopped sending.
+* @param [in/out] targs Thread arguments.
+*/
+void task_failsafe_step(const void *targs);
+#endif
+
+#if defined(TASK_COLLECT_TELEMETRY) || defined(TASK_EXECUTIVE)
+/**
+* @brief Sample every telemetry parameter that has a getter.
+* @param [in/out] targs Thread arguments.
+*/
+void task_collect_telemetry_step(const void *targs);
+#endif
+
 #if defined(TASK_CALC_ORIENTATION) && defined(DEVICE_BNO055)
 // void task_calc_escs(const void *targs);
 void task_calc_orientation(const void *targs);
 #endif
 
-#ifdef TASK_COLLECT_TELEMETRY
-void task_collect_telemetry(const void *targs);
-#endif
-
 #if defined(TASK_STREAM_TELEMETRY) && defined(DEVICE_ESP8266)
 void task_stream_telemetry(const void *targs);
 #endif
 
 #ifdef TASK_CALIBRATE_CHANNELS
-void task_calibrate_channels(const void *targs);
-#endif
+/**
+* @brief Sample the receiver channels while calibrating their limits.
+* @param [in/out] targs Thread arguments.
+*/
+void task_calibrate_channels_step(const void *targs);
 
-#ifdef TASK_CALIBRATE_CHANNELS
-void task_debug(const void *targs);
+/**
+* @brief Make the next calibration step start from the beginning, e.g. when
+*        calibration is started or stopped part way through.
+*/
+void task_calibrate_channels_restart(void);
 #endif
 
-// Debug tasks
-void task_print_channels(const void *targs);
-
-static volatile task_t tasks[] = {
-#ifdef TASK_READ_SERIAL
-  {.id = TASK_READ_SERIAL_ID,        .name = "Read Serial",        .func = task_read_serial,        .args = NULL, .priority = osPriorityRealtime, .stack_size = 1024, .active = true},
-#endif
-#ifdef TASK_PROCESS_COMMANDS
-  {.id = TASK_PROCESS_COMMANDS_ID,   .name = "Process Commands",   .func = task_process_commands,   .args = NULL, .priority = osPriorityHigh,     .stack_size = 2048, .active = true},
+#ifdef TASK_FLIGHT_LOG
+void task_flight_log(const void *targs);
 #endif
-#ifdef TASK_LED_STATE
-  {.id = TASK_LED_STATE_ID,          .name = "LED State",          .func = task_state_leds,         .args = NULL, .priority = osPriorityNormal, .stack_size = 1024,   .active = true},
-#endif
-#ifdef TASK_MOTOR_DRIVE
-  {.id = TASK_MOTOR_DRIVE_ID,        .name = "Motor Drive",        .func = task_motor_drive,        .args = NULL, .priority = osPriorityNormal, .stack_size = 1024,   .active = true},
-#endif
-#ifdef TASK_ARMING
-  {.id = TASK_ARMING_ID,             .name = "Arming" ,            .func = task_arming,             .args = NULL, .priority = osPriorityNormal, .stack_size = 1024,   .active = true},
-#endif
-#ifdef TASK_FAILSAFE
-  {.id = TASK_FAILSAFE_ID,           .name = "Failsafe" ,          .func = task_failsafe,           .args = NULL, .priority = osPriorityNormal, .stack_size = 1024,  .active = true},
-#endif
-#if defined(TASK_CALC_ORIENTATION) && defined(DEVICE_BNO055)
-  {.id = TASK_CALC_ORIENTATION_ID,   .name = "Calc Orientation",   .func = task_calc_orientation,   .args = NULL, .priority = osPriorityNormal, .stack_size = 2048,  .active = false},
+
+#ifdef TASK_STACK_MONITOR
+void task_stack_monitor(const void *targs);
 #endif
-#ifdef TASK_COLLECT_TELEMETRY
-  {.id = TASK_COLLECT_TELEMETRY_ID,  .name = "Collect Telemetry",  .func = task_collect_telemetry,  .args = NULL, .priority = osPriorityNormal, .stack_size = 1024,  .active = true},
+
+#ifdef TASK_SUPERVISOR
+void task_supervisor(const void *targs);
 #endif
-#if defined(TASK_STREAM_TELEMETRY) && defined(DEVICE_ESP8266)
-  {.id = TASK_STREAM_TELEMETRY_ID,   .name = "Stream Telemetry",   .func = task_stream_telemetry,   .args = NULL, .priority = osPriorityNormal, .stack_size = 1024,  .active = true},
+
+#ifdef TASK_LOG
+void task_log(const void *targs);
 #endif
+
 #ifdef TASK_CALIBRATE_CHANNELS
-  {.id = TASK_CALIBRATE_CHANNELS_ID, .name = "Calibrate Channels", .func = task_calibrate_channels, .args = NULL, .priority = osPriorityNormal, .stack_size = 1024,  .active = false},
-#endif
-#ifdef TASK_DEBUG
-  {.id = TASK_DEBUG_ID, .name = "Debug", .func = task_debug, .args = NULL, .priority = osPriorityNormal, .stack_size = 1024,  .active = true}
+void task_debug(const void *targs);
 #endif
-};
+
+// Debug tasks
+void task_print_channels(const void *targs);
+
+/**
+ * All tasks, indexed by task ID (defined in tasks.cpp).
+ */
+extern volatile task_t tasks[NUM_TASKS];
+
 
 #endif  // INCLUDE_TASKS_H_
@@ -26,11 +26,7 @@
 #define INCLUDE_TELE_PARAM_H_
 
 #include "stdint.h"
-
-/* TODO(camieac): I want to refactor the commands to make it easy to add new
-   ones. I'll probably add a function for each command that updates the
-   telemetry value. And a pointer to this function stored in tele_command_t.
-*/
+#include "config.h"
 
 /**
  * Supported types that can be passed as a value in a telemetry parameter.
@@ -66,6 +62,9 @@ typedef enum {
   CU_CELCIUS,
   CU_VOLTS,
   CU_DEGREES,
+  CU_MICROSECONDS,
+  CU_BYTES,
+  CU_PERCENT,
   CU_NONE
 } tele_command_unit_t;
 
@@ -76,6 +75,9 @@ static const char* tele_command_unit_str[] = {
   "celcius",
   "V",
   "degrees",
+  "us",
+  "bytes",
+  "%",
   ""
 };
 
@@ -85,34 +87,112 @@ static const char* tele_command_unit_str[] = {
 const char* tele_command_unit_to_string(tele_command_unit_t tcid);
 
 /**
- * Defines all telemetry parameters.
- * Note: For ease of access, the command ID (CID) value should correspond with its
- * position within the tele_commands array (tele_params.h).
+ * Defines all telemetry parameters. This is the only place a parameter needs
+ * to be added; the command IDs, the tele_commands array (tele_params.cpp) and
+ * name lookups are all generated from it, so a parameter's command ID (CID) is
+ * always its position within the tele_commands array.
+ *
+ * X(id, name, unit, type, aggregate, get, set)
+ *   aggregate: keep min/max/mean over each streaming window (numeric types only).
+ *              Not for angles that wrap, such as yaw (0..360) or pitch
+ *              (+/-180): 359 and 1 degrees would give a mean of 180 and a
+ *              min/max of 1/359.
+ *   get: void (*)(const void *targs, tele_value_t *value), NULL if not sampled
+ *        (e.g. arm_status, which is updated on each change of state).
+ *   set: int (*)(const void *targs, const tele_value_t *value), NULL if read only.
  */
-typedef enum tele_command_id_t {
-  CID_DRIVE_RPM_1 = 0,
-  CID_DRIVE_RPM_2,
-  CID_DRIVE_RPM_3,
-  CID_WEAPON_RPM_1,
-  CID_WEAPON_RPM_2,
-  CID_WEAPON_RPM_3,
 #ifdef DEVICE_BNO055
-  CID_ACCEL_X,
-  CID_ACCEL_Y,
-  CID_ACCEL_Z,
-  CID_PITCH,
-  CID_ROLL,
-  CID_YAW,
-  CID_AMBIENT_TEMP,
+#define TELE_PARAMS_BNO055(X) \
+  X(CID_ACCEL_X,          "accel_x",          CU_MPSPS,        CT_FLOAT, true,  tele_get_accel_x,         NULL) \
+  X(CID_ACCEL_Y,          "accel_y",          CU_MPSPS,        CT_FLOAT, true,  tele_get_accel_y,         NULL) \
+  X(CID_ACCEL_Z,          "accel_z",          CU_MPSPS,        CT_FLOAT, true,  tele_get_accel_z,         NULL) \
+  X(CID_PITCH,            "pitch",            CU_DEGREES,      CT_FLOAT, false, tele_get_pitch,           NULL) \
+  X(CID_ROLL,             "roll",             CU_DEGREES,      CT_FLOAT, true,  tele_get_roll,            NULL) \
+  X(CID_YAW,              "yaw",              CU_DEGREES,      CT_FLOAT, false, tele_get_yaw,             NULL) \
+  X(CID_AMBIENT_TEMP,     "temp",             CU_CELCIUS,      CT_INT,   false, tele_get_temp,            NULL)
+#else
+#define TELE_PARAMS_BNO055(X)
 #endif
-  CID_WEAPON_VOLTAGE_1,
-  CID_WEAPON_VOLTAGE_2,
-  CID_WEAPON_VOLTAGE_3,
-  CID_DRIVE_VOLTAGE_1,
-  CID_DRIVE_VOLTAGE_2,
-  CID_DRIVE_VOLTAGE_3,
-  CID_ARM_STATUS,
-};
+
+#ifdef TASK_STACK_MONITOR
+#define TELE_PARAMS_MEM(X) \
+  X(CID_HEAP_USED,        "heap_used",        CU_BYTES,        CT_INT,   false, tele_get_heap_used,       NULL) \
+  X(CID_HEAP_PEAK,        "heap_peak",        CU_BYTES,        CT_INT,   false, tele_get_heap_peak,       NULL) \
+  X(CID_HEAP_ALLOCS,      "heap_allocs",      CU_NONE,         CT_INT,   false, tele_get_heap_allocs,     NULL) \
+  X(CID_ISR_STACK_PEAK,   "isr_stack_peak",   CU_BYTES,        CT_INT,   false, tele_get_isr_stack_peak,  NULL) \
+  X(CID_TASK_STACK_PEAK,  "task_stack_peak",  CU_PERCENT,      CT_INT,   false, tele_get_task_stack_peak, NULL)
+#else
+#define TELE_PARAMS_MEM(X)
+#endif
+
+// TODO(camieac): Add support for drive RPM and voltage sensing
+#define TELE_PARAMS(X) \
+  X(CID_DRIVE_RPM_1,      "drive_rpm_1",      CU_RPM,          CT_FLOAT, true,  NULL,                     NULL) \
+  X(CID_DRIVE_RPM_2,      "drive_rpm_2",      CU_RPM,          CT_FLOAT, true,  NULL,                     NULL) \
+  X(CID_DRIVE_RPM_3,      "drive_rpm_3",      CU_RPM,          CT_FLOAT, true,  NULL,                     NULL) \
+  X(CID_WEAPON_RPM_1,     "weapon_rpm_1",     CU_RPM,          CT_FLOAT, true,  tele_get_weapon_rpm_1,   NULL) \
+  X(CID_WEAPON_RPM_2,     "weapon_rpm_2",     CU_RPM,          CT_FLOAT, true,  tele_get_weapon_rpm_2,   NULL) \
+  X(CID_WEAPON_RPM_3,     "weapon_rpm_3",     CU_RPM,          CT_FLOAT, true,  tele_get_weapon_rpm_3,   NULL) \
+  TELE_PARAMS_BNO055(X) \
+  X(CID_WEAPON_VOLTAGE_1, "weapon_voltage_1", CU_VOLTS,        CT_FLOAT, true,  NULL,                     NULL) \
+  X(CID_WEAPON_VOLTAGE_2, "weapon_voltage_2", CU_VOLTS,        CT_FLOAT, true,  NULL,                     NULL) \
+  X(CID_WEAPON_VOLTAGE_3, "weapon_voltage_3", CU_VOLTS,        CT_FLOAT, true,  NULL,                     NULL) \
+  X(CID_DRIVE_VOLTAGE_1,  "drive_voltage_1",  CU_VOLTS,        CT_FLOAT, true,  NULL,                     NULL) \
+  X(CID_DRIVE_VOLTAGE_2,  "drive_voltage_2",  CU_VOLTS,        CT_FLOAT, true,  NULL,                     NULL) \
+  X(CID_DRIVE_VOLTAGE_3,  "drive_voltage_3",  CU_VOLTS,        CT_FLOAT, true,  NULL,                     NULL) \
+  X(CID_ARM_STATUS,       "arm_status",       CU_NONE,         CT_INT,   false, NULL,                     NULL) \
+  X(CID_DEADLINE_MISSES,  "deadline_misses",  CU_NONE,         CT_INT,   false, tele_get_deadline_misses, NULL) \
+  X(CID_CONTROL_WCRT,     "control_wcrt",     CU_MICROSECONDS, CT_INT,   false, tele_get_control_wcrt,    NULL) \
+  TELE_PARAMS_MEM(X)
+
+#define TELE_PARAM_ENUM(id, name, unit, type, aggregate, get, set) id,
+
+/**
+ * Telemetry command IDs, generated from TELE_PARAMS.
+ */
+typedef enum tele_command_id_t {
+  TELE_PARAMS(TELE_PARAM_ENUM)
+  TELE_COMMAND_COUNT
+} tele_command_id_t;
+
+#define NUM_TELE_COMMANDS ((unsigned) TELE_COMMAND_COUNT)
+
+/**
+ * Stores a value as one of a number of types.
+ */
+typedef union {
+  float f;
+  int i;
+  char c;
+  bool b;
+  const char *s;
+} tele_value_t;
+
+/**
+ * Incremental min/max/mean of a numeric parameter over a streaming window,
+ * updated every time the parameter is sampled.
+ */
+typedef struct {
+  float min;
+  float max;
+  float sum;
+  uint32_t count;
+} tele_aggregate_t;
+
+/**
+* @brief Empty an aggregation window.
+*/
+void tele_aggregate_reset(tele_aggregate_t *window);
+
+/**
+* @brief Add a sample to an aggregation window.
+*/
+void tele_aggregate_add(tele_aggregate_t *window, float sample);
+
+/**
+* @return Mean of the samples in the window, 0 if empty.
+*/
+float tele_aggregate_mean(const tele_aggregate_t *window);
 
 /**
  * This info stores the name and value of a parameter to be sent to ESP8266.
@@ -125,15 +205,29 @@ typedef struct {
   tele_command_type_t type;
 
   /**
-   * Allow one of many types to be used.
+   * Keep min/max/mean over the streaming window.
+   */
+  bool aggregate;
+
+  /**
+   * Sample the current value of the parameter, NULL if not sampled.
+   */
+  void (*get)(const void *targs, tele_value_t *value);
+
+  /**
+   * Change the parameter, NULL if the parameter is read only.
+   */
+  int (*set)(const void *targs, const tele_value_t *value);
+
+  /**
+   * Last sampled value.
+   */
+  tele_value_t param;
+
+  /**
+   * Samples since the window was last streamed, if aggregate is set.
    */
-  union {
-    float f;
-    int i;
-    char c;
-    bool b;
-    const char *s;
-  } param;
+  tele_aggregate_t window;
 
 } tele_command_t;
 
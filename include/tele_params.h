@@ -25,33 +25,73 @@
 #ifndef INCLUDE_TELE_PARAMS_H_
 #define INCLUDE_TELE_PARAMS_H_
 
+#include <stddef.h>
+#include <stdint.h>
 #include "tele_param.h"
 
-static tele_command_t tele_commands[] = {
-  {.id = CID_DRIVE_RPM_1, .name = "drive_rpm_1", .unit = CU_RPM, .type = CT_FLOAT},
-  {.id = CID_DRIVE_RPM_2, .name = "drive_rpm_2", .unit = CU_RPM, .type = CT_FLOAT},
-  {.id = CID_DRIVE_RPM_3, .name = "drive_rpm_3", .unit = CU_RPM, .type = CT_FLOAT},
-  {.id = CID_WEAPON_RPM_1, .name = "weapon_rpm_1", .unit = CU_RPM, .type = CT_FLOAT},
-  {.id = CID_WEAPON_RPM_2, .name = "weapon_rpm_2", .unit = CU_RPM, .type = CT_FLOAT},
-  {.id = CID_WEAPON_RPM_3, .name = "weapon_rpm_3", .unit = CU_RPM, .type = CT_FLOAT},
+/**
+ * All telemetry parameters, indexed by tele_command_id_t.
+ */
+extern tele_command_t tele_commands[NUM_TELE_COMMANDS];
+
+/* Bit for one parameter in a bulk request, and the bits for all of them */
+#define TELE_PARAM_MASK(id) ((uint64_t) 1 << (id))
+#define TELE_PARAM_MASK_ALL (TELE_PARAM_MASK(NUM_TELE_COMMANDS) - 1)
+
+/* Bulk requests select parameters with a 64 bit mask */
+typedef char tele_params_fit_mask[(NUM_TELE_COMMANDS < 64) ? 1 : -1];
+
+/**
+* @brief Build the name lookup table, call once before tele_param_find().
+* @return True if a perfect hash was found for the parameter names.
+*/
+bool tele_params_init(void);
+
+/**
+* @brief Find a telemetry parameter by ID.
+* @param [in] id Command ID of the parameter.
+* @return Pointer to the parameter, NULL if id is out of range.
+*/
+tele_command_t * tele_param_get(unsigned id);
+
+/**
+* @brief Find a telemetry parameter by name.
+* @param [in] name Name of the parameter (need not be null terminated).
+* @param [in] len Length of name.
+* @return Pointer to the parameter, NULL if there is no parameter called name.
+*/
+tele_command_t * tele_param_find(const char *name, size_t len);
+
+/**
+* @brief Read the sensors that several getters share, once per sample.
+* @details Call before the getters in each sample. The accel and euler
+*          getters then read from this copy, so a sample costs one I2C read
+*          of each rather than one per axis.
+*/
+void tele_params_sample(const void *targs);
+
+/* Getters and setters referenced by TELE_PARAMS */
+
 #ifdef DEVICE_BNO055
-  {.id = CID_ACCEL_X, .name = "accel_x", .unit = CU_MPSPS, .type = CT_FLOAT},
-  {.id = CID_ACCEL_Y, .name = "accel_y", .unit = CU_MPSPS, .type = CT_FLOAT},
-  {.id = CID_ACCEL_Z, .name = "accel_z", .unit = CU_MPSPS, .type = CT_FLOAT},
-  {.id = CID_PITCH, .name = "pitch", .unit = CU_DEGREES, .type = CT_FLOAT},
-  {.id = CID_ROLL, .name = "roll", .unit = CU_DEGREES, .type = CT_FLOAT},
-  {.id = CID_YAW, .name = "yaw", .unit = CU_DEGREES, .type = CT_FLOAT},
-  {.id = CID_AMBIENT_TEMP, .name = "temp", .unit = CU_CELCIUS, .type = CT_INT},
+void tele_get_accel_x(const void *targs, tele_value_t *value);
+void tele_get_accel_y(const void *targs, tele_value_t *value);
+void tele_get_accel_z(const void *targs, tele_value_t *value);
+void tele_get_pitch(const void *targs, tele_value_t *value);
+void tele_get_roll(const void *targs, tele_value_t *value);
+void tele_get_yaw(const void *targs, tele_value_t *value);
+void tele_get_temp(const void *targs, tele_value_t *value);
+#endif
+void tele_get_weapon_rpm_1(const void *targs, tele_value_t *value);
+void tele_get_weapon_rpm_2(const void *targs, tele_value_t *value);
+void tele_get_weapon_rpm_3(const void *targs, tele_value_t *value);
+void tele_get_deadline_misses(const void *targs, tele_value_t *value);
+void tele_get_control_wcrt(const void *targs, tele_value_t *value);
+#ifdef TASK_STACK_MONITOR
+void tele_get_heap_used(const void *targs, tele_value_t *value);
+void tele_get_heap_peak(const void *targs, tele_value_t *value);
+void tele_get_heap_allocs(const void *targs, tele_value_t *value);
+void tele_get_isr_stack_peak(const void *targs, tele_value_t *value);
+void tele_get_task_stack_peak(const void *targs, tele_value_t *value);
 #endif
-  {.id = CID_WEAPON_VOLTAGE_1, .name = "weapon_voltage_1", .unit = CU_VOLTS, .type = CT_FLOAT},
-  {.id = CID_WEAPON_VOLTAGE_2, .name = "weapon_voltage_2", .unit = CU_VOLTS, .type = CT_FLOAT},
-  {.id = CID_WEAPON_VOLTAGE_3, .name = "weapon_voltage_3", .unit = CU_VOLTS, .type = CT_FLOAT},
-  {.id = CID_DRIVE_VOLTAGE_1, .name = "drive_voltage_1", .unit = CU_VOLTS, .type = CT_FLOAT},
-  {.id = CID_DRIVE_VOLTAGE_2, .name = "drive_voltage_2", .unit = CU_VOLTS, .type = CT_FLOAT},
-  {.id = CID_DRIVE_VOLTAGE_3, .name = "drive_voltage_3", .unit = CU_VOLTS, .type = CT_FLOAT},
-  {.id = CID_ARM_STATUS, .name = "arm_status", .unit = CU_NONE, .type = CT_INT},
-};
-
-#define NUM_TELE_COMMANDS (sizeof(tele_commands) / sizeof(tele_command_t))
 
 #endif  // INCLUDE_TELE_PARAMS_H_
@@ -37,6 +37,8 @@
 #include "drive_mode.h"
 #include "comms.h"
 #include "watchdog.h"
+#include "flight_log.h"
+#include "cli.h"
 
 /**
  * Shared variables between tasks, made availbale through the first and only
@@ -47,7 +49,11 @@ typedef struct {
   task_t *tasks;
   Thread *threads;
 
-  state_t state;
+  /*! Arming state, only changed through state_raise(). */
+  volatile state_t state;
+
+  /*! ESC outputs that may be driven (ESC_GATE_*), follows the state. */
+  volatile uint32_t esc_gate;
 
   /*! Drive mode in use. */
   drive_mode_t *drive_mode;
@@ -64,17 +70,17 @@ typedef struct {
   /*! Receiver inputs. */
   rc_receiver_t receiver[RC_NUMBER_CONTROLLERS];
 
-  /*! Defines the upper and lower limits of each PWM input from a receiver. */
-  channel_limits_t channel_limits[RC_NUMBER_CONTROLLERS][RC_NUMBER_CHANNELS];
-
   /*! Mail queue for commands from serial comms or RF RX */
   Mail<command_t, COMMAND_QUEUE_LEN> *command_queue;
 
-  /*! USB serial port */
-  Serial *serial;
+  /*! Mail queue for commands that must not wait behind the main queue */
+  Mail<command_t, SAFETY_COMMAND_QUEUE_LEN> *safety_command_queue;
+
+  /*! USB serial port (RawSerial, as it is read from an ISR) */
+  LockedSerial *serial;
 
-  /*! Serial connection to ESP8266 */
-  Serial *esp_serial;
+  /*! Serial connection to ESP8266 (RawSerial, as it is read from an ISR) */
+  RawSerial *esp_serial;
   DigitalIn *esp_ready_pin;
 
   /*! Stores telemetry values */
@@ -107,6 +113,10 @@ typedef struct {
      * Mutual exclusion of serial port.
      */
     Mutex *pc_serial;
+    /**
+     * Mutual exclusion of ESP8266 serial port.
+     */
+    Mutex *esp_serial;
     /**
      * Protects accesses to controller values.
      */
@@ -127,11 +137,12 @@ typedef struct {
 
   bool heading_lock_enabled;
   float heading_lock; // heading to rotate to
-  int heading_lock_speed; // percentage
-  int heading_lock_deadband; // degrees / 2
 
   Watchdog *wdt;
 
+  /*! Binary log of control loop snapshots. */
+  flight_log_t *flight_log;
+
 } thread_args_t;
 
 /**
@@ -14,11 +14,63 @@
 
 #include "mbed.h"
 #include <stdarg.h>
+#include "config.h"
+#include "log_queue.h"
 
-extern Serial *serial_ptr;
+extern RawSerial *serial_ptr;
 
+#define LOG_LEVEL_NONE  0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN  2
+#define LOG_LEVEL_INFO  3
+#define LOG_LEVEL_DEBUG 4
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+#ifdef TASK_LOG
+/* Console output, e.g. command replies. Queued for the log writer thread,
+   waiting for room rather than losing part of a listing. */
+#define LOG( args...) \
+  log_queue_print(args)
+
+/* Messages from tasks. Queued without formatting on the given channel and
+   never wait, a message that does not fit is dropped and counted. */
+#define LOG_MESSAGE( channel, args...) \
+  log_queue_write(channel, args)
+#else
 //Legacy function, TODO: remove
 #define LOG( args...) \
-  serial_ptr->printf(args); \
+  serial_ptr->printf(args)
+
+#define LOG_MESSAGE( channel, args...) \
+  serial_ptr->printf(args)
+#endif
+
+/* Levels above LOG_LEVEL compile to nothing, their arguments are not evaluated */
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_ERROR( args...) LOG_MESSAGE(LOG_CHANNEL_ALERT, args)
+#else
+#define LOG_ERROR( args...) do {} while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_WARN
+#define LOG_WARN( args...) LOG_MESSAGE(LOG_CHANNEL_ALERT, args)
+#else
+#define LOG_WARN( args...) do {} while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO( args...) LOG_MESSAGE(LOG_CHANNEL_DEBUG, args)
+#else
+#define LOG_INFO( args...) do {} while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG( args...) LOG_MESSAGE(LOG_CHANNEL_DEBUG, args)
+#else
+#define LOG_DEBUG( args...) do {} while (0)
+#endif
 
 #endif
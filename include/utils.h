@@ -39,14 +39,26 @@
       typeof (b) _b = (b); \
     _a < _b ? _a : _b; })
 
+/**
+* @brief Receiver channel watched for a drive stall.
+*/
+PwmIn *drive_stall_channel(thread_args_t *args);
+
+/**
+* @brief Receiver channel watched for a weapon stall.
+*/
+PwmIn *weapon_stall_channel(thread_args_t *args);
+
 /**
 * @brief Check if drive reciever is stalled.
+* @param [in] timeout_ms Time without a pulse before the receiver is stalled.
 */
-bool is_drive_stalled(thread_args_t *args);
+bool is_drive_stalled(thread_args_t *args, int timeout_ms);
 
 /**
 * @brief Check if weapon reciever is stalled.
+* @param [in] timeout_ms Time without a pulse before the receiver is stalled.
 */
-bool is_weapon_stalled(thread_args_t *args);
+bool is_weapon_stalled(thread_args_t *args, int timeout_ms);
 
 #endif //TC_UTILS_H
@@ -0,0 +1,86 @@
+/* Copyright (c) 2018 Cameron A. Craig, MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ * BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * @file warm_start.h
+ * @author Cameron A. Craig
+ * @date 14 Mar 2018
+ * @copyright 2018 Cameron A. Craig
+ * @brief Control state kept in no-init RAM, to resume quickly after a watchdog reset.
+ */
+
+#ifndef TC_WARM_START_H
+#define TC_WARM_START_H
+
+#include "thread_args.h"
+#include "settings.h"
+
+/* Re-arming rule: a watchdog reset restores the arming state from before
+   the hang, whichever task hung. When the supervisor sees a missed heartbeat
+   it stops the ESCs with esc_gate_shut(), which leaves the state alone, so a
+   motor drive task that is still running keeps saving the armed state and
+   one that hung has already saved it. Anything that should come back
+   disarmed must disarm through the state machine before the reset. */
+
+/**
+ * Control state saved by the motor drive task every iteration.
+ */
+typedef struct {
+  state_t state;
+  orientation_t orientation_detected;
+  orientation_t orientation_override;
+  bool inverted;
+  bool heading_lock_enabled;
+  float heading_lock;
+  /*! Last frame sent to the ESCs. */
+  struct rc_outputs_t outputs;
+} warm_control_t;
+
+/**
+* @brief Save the control state, call once per control loop iteration.
+* @details Only the motor drive task may call this.
+*/
+void warm_start_save_control(const thread_args_t *args);
+
+/**
+* @brief Save the run time settings, including drive/weapon mode and the
+*        channel calibration.
+* @details Called by settings_edit_commit(), so only one writer at a time.
+*/
+void warm_start_save_settings(const settings_t *settings);
+
+/**
+* @brief Check whether the saved state survived the reset intact.
+* @return True if both the control state and the settings are valid.
+*/
+bool warm_start_available(void);
+
+/**
+* @brief Restore the saved settings and control state into args.
+* @details Call after settings_init(), and only if warm_start_available().
+*          Outputs are not written to the ESCs, call set_output_escs() next.
+*          If the saved settings fail settings_validate(), nothing is
+*          restored and the robot stays disarmed.
+*/
+void warm_start_restore(thread_args_t *args);
+
+/**
+* @brief Forget the saved state and save the current settings, on a cold boot.
+* @details Call after settings_init(), instead of warm_start_restore().
+*/
+void warm_start_reset(void);
+
+#endif  // TC_WARM_START_H
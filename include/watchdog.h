@@ -26,6 +26,9 @@
 #define TC_WATCHDOG_H
 
 #include "mbed.h"
+
+/* Longest reset reason that can be recorded */
+#define WATCHDOG_REASON_LEN 16
 /** @class Watchdog
     @brief Provides kick and test functions for the LPC1786 watchdog timer(wdt).
 */
@@ -46,6 +49,20 @@ class Watchdog {
   * @return True if reset was triggered by watchdog, false otherwise.
   */
   bool is_wdt_reset(void);
+
+  /**
+  * @brief Record why the watchdog is about to be allowed to reset the system.
+  * @details Kept in the RTC general purpose registers, which survive a reset.
+  * @param [in] reason Short description, truncated to WATCHDOG_REASON_LEN.
+  */
+  void set_reset_reason(const char *reason);
+
+  /**
+  * @brief Read the reason recorded before the last reset, and forget it.
+  * @param [out] reason Buffer of at least WATCHDOG_REASON_LEN + 1 bytes.
+  * @return True if a reason was recorded.
+  */
+  bool take_reset_reason(char *reason);
 };
 
 #endif //TC_WATCHDOG_H
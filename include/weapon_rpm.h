@@ -0,0 +1,55 @@
+/* Copyright (c) 2018 Cameron A. Craig, MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ * BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * @file weapon_rpm.h
+ * @author Cameron A. Craig
+ * @date 26 Mar 2018
+ * @copyright 2018 Cameron A. Craig
+ * @brief Measures weapon motor speed from a tachometer pulse on each motor.
+ */
+
+#ifndef TC_WEAPON_RPM_H
+#define TC_WEAPON_RPM_H
+
+#include <stdint.h>
+
+/* Weapon motors with a tachometer input */
+#define WEAPON_RPM_MOTORS 3
+
+/**
+* @brief Start timing the tachometer pulses of each weapon motor that has a
+*        pin (WEAPON_TACHO_*_PIN not NC).
+*/
+void weapon_rpm_init(void);
+
+/**
+* @brief Whether a weapon motor has a tachometer to close the loop around.
+* @param [in] motor Weapon motor, 0 --> WEAPON_RPM_MOTORS - 1.
+* @return false if its WEAPON_TACHO_*_PIN is NC.
+*/
+bool weapon_rpm_sensed(unsigned motor);
+
+/**
+* @brief Speed of a weapon motor, timed over its last full revolution.
+* @details Safe to call from any context, never blocks.
+* @param [in] motor Weapon motor, 0 --> WEAPON_RPM_MOTORS - 1.
+* @return RPM, or 0 if the motor has no tachometer or no pulse has been seen
+*         for WEAPON_TACHO_TIMEOUT_MS.
+*/
+int32_t weapon_rpm_read(unsigned motor);
+
+#endif //TC_WEAPON_RPM_H
@@ -0,0 +1,80 @@
+/* Copyright (c) 2018 Cameron A. Craig, MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ * BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * @file boot_trace.cpp
+ * @author Cameron A. Craig
+ * @date 15 Mar 2018
+ * @copyright 2018 Cameron A. Craig
+ * @brief Records when each stage of start up begins, to see where boot time goes.
+ */
+
+#include "mbed.h"
+#include "boot_trace.h"
+
+typedef struct {
+  const char *name;
+  uint32_t start_us;
+} boot_stage_t;
+
+static boot_stage_t stages[BOOT_TRACE_MAX_STAGES];
+static unsigned num_stages = 0;
+
+static volatile uint32_t first_output_us = 0;
+static volatile bool first_output_done = false;
+
+void boot_trace(const char *name) {
+  if (num_stages < BOOT_TRACE_MAX_STAGES) {
+    stages[num_stages].name = name;
+    stages[num_stages].start_us = us_ticker_read();
+    num_stages++;
+  }
+}
+
+void boot_trace_first_output(void) {
+  if (!first_output_done) {
+    first_output_us = us_ticker_read();
+    first_output_done = true;
+  }
+}
+
+void boot_trace_print(LockedSerial *serial) {
+  uint32_t now_us = us_ticker_read();
+  unsigned i;
+
+  serial->acquire();
+  // us_ticker starts on first use, so time before main() is missing
+  serial->printf("\rBoot timeline (ms since the us ticker started, about the start of main())\r\n");
+  serial->printf("\r%-24s %9s %9s\r\n", "Stage", "Start", "Took");
+  for (i = 0; i < num_stages; i++) {
+    uint32_t end_us = (i + 1 < num_stages) ? stages[i + 1].start_us : now_us;
+    uint32_t took_us = end_us - stages[i].start_us;
+    serial->printf("\r%-24s %5lu.%03lu %5lu.%03lu\r\n",
+      stages[i].name,
+      (unsigned long) (stages[i].start_us / 1000), (unsigned long) (stages[i].start_us % 1000),
+      (unsigned long) (took_us / 1000), (unsigned long) (took_us % 1000));
+  }
+  serial->printf("\r%-24s %5lu.%03lu\r\n", "Boot complete",
+    (unsigned long) (now_us / 1000), (unsigned long) (now_us % 1000));
+
+  if (first_output_done) {
+    serial->printf("\r>>> main() to first ESC command: %lu.%03lu ms <<<\r\n",
+      (unsigned long) (first_output_us / 1000), (unsigned long) (first_output_us % 1000));
+  } else {
+    serial->printf("\r>>> No ESC command sent yet <<<\r\n");
+  }
+  serial->release();
+}
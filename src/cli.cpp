@@ -0,0 +1,219 @@
+/* Copyright (c) 2018 Cameron A. Craig, MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ * BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * @file cli.cpp
+ * @author Cameron A. Craig
+ * @date 24 Feb 2018
+ * @copyright 2018 Cameron A. Craig
+ * @brief Interrupt driven line editor for the USB serial command line interface.
+ */
+
+#include "mbed.h"
+#include "rtos.h"
+#include "cli.h"
+#include "config.h"
+#include "link.h"
+#include "log_queue.h"
+
+#define CLI_BACKSPACE 0x08
+#define CLI_DELETE    0x7F
+#define CLI_KILL_LINE 0x15  // Ctrl-U
+#define CLI_BELL      0x07
+
+static RawSerial *cli_serial;
+
+/* Line being edited, only touched by the ISR. */
+static char edit_line[CLI_LINE_LENGTH];
+static size_t edit_len;
+static char last_char;
+
+/* Completed lines, written by the ISR and read by cli_read_line(). */
+static char lines[CLI_LINE_QUEUE_LEN][CLI_LINE_LENGTH];
+static volatile uint32_t lines_head;
+static volatile uint32_t lines_tail;
+static volatile uint32_t overruns;
+static Semaphore lines_ready(0);
+
+/* Echoed characters, written by the ISR and read by cli_echo_flush(). */
+static char echo[CLI_ECHO_LEN];
+static volatile uint32_t echo_head;
+static volatile uint32_t echo_tail;
+static volatile uint32_t echo_dropped;
+
+typedef char cli_echo_len_is_power_of_two[((CLI_ECHO_LEN & (CLI_ECHO_LEN - 1)) == 0) ? 1 : -1];
+
+void LockedSerial::lock(void) {
+  if (!core_util_is_isr_active()) {
+    _mutex->lock();
+  }
+}
+
+void LockedSerial::unlock(void) {
+  if (!core_util_is_isr_active()) {
+    _mutex->unlock();
+  }
+}
+
+/**
+* @brief Move the edited line onto the completed line queue.
+*/
+static void cli_complete_line(void) {
+  edit_line[edit_len] = '\0';
+
+  if (lines_head - lines_tail >= CLI_LINE_QUEUE_LEN) {
+    overruns++;
+  } else {
+    memcpy(lines[lines_head % CLI_LINE_QUEUE_LEN], edit_line, edit_len + 1);
+    lines_head++;
+    lines_ready.release();
+  }
+  edit_len = 0;
+}
+
+/**
+* @brief Echo a character without waiting for the UART.
+* @details With the log task the character is queued for it to write
+*          between messages, otherwise it is only written if the transmit
+*          FIFO has room. Either way it is dropped rather than waited for.
+*/
+static void cli_echo(char c) {
+#ifdef TASK_LOG
+  if (echo_head - echo_tail >= CLI_ECHO_LEN) {
+    echo_dropped++;
+    return;
+  }
+  echo[echo_head % CLI_ECHO_LEN] = c;
+  echo_head++;
+#else
+  if (cli_serial->writeable()) {
+    cli_serial->putc(c);
+  } else {
+    echo_dropped++;
+  }
+#endif
+}
+
+/**
+* @brief Erase the last character from the edited line and the terminal.
+*/
+static void cli_erase_char(void) {
+  edit_len--;
+  cli_echo(CLI_BACKSPACE);
+  cli_echo(' ');
+  cli_echo(CLI_BACKSPACE);
+}
+
+/**
+* @brief Edit the current line with each received character.
+* @note Runs in interrupt context. Only the characters that change are
+*       echoed, the line is never reprinted. Never waits for the UART.
+*/
+static void cli_rx_isr(void) {
+  uint32_t echoed = echo_head;
+
+  while (cli_serial->readable()) {
+    char c = cli_serial->getc();
+
+#ifdef TASK_PROCESS_COMMANDS
+    // Binary requests from a test rig share the port with the command line
+    if (link_usb_feed(c)) {
+      continue;
+    }
+#endif
+
+    switch (c) {
+      case '\n':
+        // Treat "\r\n" as a single line ending
+        if (last_char == '\r') {
+          break;
+        }
+      // Fall through
+      case '\r':
+        // Queued before the line, so it is written out before any reply
+        cli_echo('\r');
+        cli_echo('\n');
+        cli_complete_line();
+        break;
+      case CLI_BACKSPACE:
+      case CLI_DELETE:
+        if (edit_len > 0) {
+          cli_erase_char();
+        }
+        break;
+      case CLI_KILL_LINE:
+        while (edit_len > 0) {
+          cli_erase_char();
+        }
+        break;
+      default:
+        if (c >= ' ' && c <= '~' && edit_len < CLI_LINE_LENGTH - 1) {
+          edit_line[edit_len++] = c;
+          cli_echo(c);
+        } else {
+          cli_echo(CLI_BELL);
+        }
+        break;
+    }
+    last_char = c;
+  }
+
+  if (echo_head != echoed) {
+    log_queue_wake();
+  }
+}
+
+void cli_init(RawSerial *serial) {
+  cli_serial = serial;
+  edit_len = 0;
+  serial->attach(&cli_rx_isr, RawSerial::RxIrq);
+}
+
+size_t cli_read_line(char *line, size_t size) {
+  lines_ready.wait(osWaitForever);
+
+  const char *next = lines[lines_tail % CLI_LINE_QUEUE_LEN];
+  size_t len = strlen(next);
+  if (len >= size) {
+    len = size - 1;
+  }
+  memcpy(line, next, len);
+  line[len] = '\0';
+  lines_tail++;
+
+  return len;
+}
+
+uint32_t cli_overruns(void) {
+  return overruns;
+}
+
+void cli_echo_flush(LockedSerial *serial) {
+  if (echo_tail == echo_head) {
+    return;
+  }
+  // Held across the whole echo, so it never lands inside a log line
+  serial->acquire();
+  while (echo_tail != echo_head) {
+    serial->putc(echo[echo_tail % CLI_ECHO_LEN]);
+    echo_tail++;
+  }
+  serial->release();
+}
+
+uint32_t cli_echo_dropped(void) {
+  return echo_dropped;
+}
@@ -33,112 +33,373 @@
 #include "types.h"
 #include "tele_params.h"
 #include "tasks.h"
+#include "link.h"
+#include "lookup.h"
+#include "task_control.h"
+#include "settings.h"
+#include "mem_stats.h"
+#include "esc_cutoff.h"
+#include "cli.h"
 
 const char * command_get_str(command_id_t id) {
-  if (id > 0 && id < NUM_COMMANDS)
+  if ((unsigned) id < NUM_COMMANDS)
     return available_commands[id].name;
   else
     return "INVALID COMMAND";
 }
 
-int command_generate(command_t *command, char *buffer) {
-  // Get the size of the entire command string
-  size_t command_len = strlen(buffer);
-  char command_str[command_len];
-  memcpy(command_str, buffer, command_len);
-
-  // Seperate commands into parts
-  char param_part[2][10];
-  char command_part[10];
-
-  char * pch;
-  int part = 0;
-  pch = strtok (command_str," ");
-  while (pch != NULL){
-    if(part == 0){
-      strncpy(command_part, pch, strlen(pch));
-    } else {
-      strncpy(param_part[part-1], pch, strlen(pch));
+static lookup_table_t command_lookup;
+
+static const char * command_name(unsigned index) {
+  return available_commands[index].name;
+}
+
+bool command_init(void) {
+  return lookup_build(&command_lookup, command_name, NUM_COMMANDS);
+}
+
+size_t command_tokenize(const char *buffer, token_t *tokens, size_t max_tokens) {
+  size_t count = 0;
+  const char *c = buffer;
+
+  while (*c != '\0') {
+    // Skip separating spaces
+    while (*c == ' ') {
+      c++;
+    }
+    if (*c == '\0') {
+      break;
+    }
+    if (count == max_tokens) {
+      return max_tokens + 1;
     }
-    pch = strtok (NULL, " ");
-    part++;
-  }
-
-  // Find a matching command for the given command string
-  int i;
-  for (i = 0; i < NUM_COMMANDS; i++) {
-    size_t cplen = strlen(command_part);
-    char *command_compare;
-    command_compare = (char *) command_get_str(available_commands[i].id);
-    size_t cclen = strlen(command_compare);
-
-    if (strncmp(command_compare, command_part, MIN(cclen, cplen)) == 0) {
-      // When a matching command is found, populate the command
-      command->id = available_commands[i].id;
-      command->name = available_commands[i].name;
-
-      if (command->id == GET_PARAM || command->id == SET_PARAM) {
-        int k;
-        for (k = 0; k < NUM_TELE_COMMANDS; k++) {
-          printf("Checking %s\r\n", tele_commands[k].name);
-          if (strncmp(param_part[0],
-            tele_commands[k].name,
-            MIN(strlen(param_part[0]), strlen(tele_commands[k].name))) == 0) {
-            command->tele_param = &tele_commands[k];
-            printf("%s %s\r\n", command_get_str(command->id), tele_commands[k].name);
-            break;
-          }
-        }
-      }
 
-      if (command->id == SET_PARAM) {
-        char *end;
-        switch (command->tele_param->type) {
-            case CT_INT:
-              command->value.i = strtol(param_part[1], &end, 10);
-              if (end == param_part[1]) {
-                printf("Conversion error\r\n");
-                return RET_ERROR;
-              }
-              printf("d: %d\r\n", command->value.i);
-              break;
-            case CT_FLOAT:
-              command->value.f = strtod(param_part[1], &end);
-              if (end == param_part[1]) {
-                printf("Conversion error\r\n");
-                return RET_ERROR;
-              }
-              printf("f: %f\r\n", command->value.f);
-              break;
-            case CT_BOOLEAN:
-              command->value.b = (strtod(param_part[1], &end) == 1);
-              if (param_part[1] == end) {
-                return RET_ERROR;
-              }
-              return RET_OK;
-            case CT_STRING:
-            default:
-              printf("unsupported param\r\n");
-              return RET_ERROR;
-        }
+    tokens[count].ptr = c;
+    while (*c != ' ' && *c != '\0') {
+      c++;
+    }
+    tokens[count].len = c - tokens[count].ptr;
+    count++;
+  }
+  return count;
+}
+
+/**
+* @brief Parse a value token according to the type of the parameter.
+* @details Tokens are not terminated, but end at a space or the end of the
+*          command string, so the conversion must stop exactly there.
+*/
+static int command_parse_value(command_t *command, tele_command_type_t type, const token_t *token) {
+  char *end;
+  const char *expected_end = token->ptr + token->len;
+
+  switch (type) {
+    case CT_INT:
+      command->value.i = strtol(token->ptr, &end, 10);
+      break;
+    case CT_FLOAT:
+      command->value.f = strtod(token->ptr, &end);
+      break;
+    case CT_BOOLEAN:
+      command->value.b = (strtol(token->ptr, &end, 10) == 1);
+      break;
+    case CT_STRING:
+    default:
+      return RET_ERROR;
+  }
+  return (end == expected_end) ? RET_OK : RET_ERROR;
+}
+
+/**
+* @brief Compare a token with a null terminated word.
+*/
+static bool token_equals(const token_t *token, const char *word) {
+  return strlen(word) == token->len && memcmp(word, token->ptr, token->len) == 0;
+}
+
+/**
+* @brief Parse "task list", "task stack", "task stop|start <name>" or
+*        "task rate <name> <hz>".
+*/
+static int command_parse_task(command_t *command, const token_t *tokens, size_t num_tokens) {
+  size_t expected_tokens;
+
+  if (num_tokens < 2) {
+    return RET_ERROR;
+  }
+
+  if (token_equals(&tokens[1], "list")) {
+    command->task_op = TASK_OP_LIST;
+    return (num_tokens == 2) ? RET_OK : RET_ERROR;
+  } else if (token_equals(&tokens[1], "stack")) {
+    command->task_op = TASK_OP_STACK;
+    return (num_tokens == 2) ? RET_OK : RET_ERROR;
+  } else if (token_equals(&tokens[1], "stop")) {
+    command->task_op = TASK_OP_STOP;
+    expected_tokens = 3;
+  } else if (token_equals(&tokens[1], "start")) {
+    command->task_op = TASK_OP_START;
+    expected_tokens = 3;
+  } else if (token_equals(&tokens[1], "rate")) {
+    command->task_op = TASK_OP_RATE;
+    expected_tokens = 4;
+  } else {
+    return RET_ERROR;
+  }
+
+  if (num_tokens != expected_tokens) {
+    return RET_ERROR;
+  }
+
+  int task_id = task_find(tokens[2].ptr, tokens[2].len);
+  if (task_id < 0) {
+    return RET_ERROR;
+  }
+  command->task_id = task_id;
+
+  if (command->task_op == TASK_OP_RATE) {
+    char *end;
+    command->value.i = strtol(tokens[3].ptr, &end, 10);
+    if (end != tokens[3].ptr + tokens[3].len ||
+        command->value.i < 1 || command->value.i > 1000) {
+      return RET_ERROR;
+    }
+  }
+  return RET_OK;
+}
+
+/**
+* @brief Parse "cfg list", "cfg get <name>" or "cfg set <name> <value>".
+*/
+static int command_parse_config(command_t *command, const token_t *tokens, size_t num_tokens) {
+  size_t expected_tokens;
+
+  if (num_tokens < 2) {
+    return RET_ERROR;
+  }
+
+  if (token_equals(&tokens[1], "list")) {
+    command->config_op = CONFIG_OP_LIST;
+    return (num_tokens == 2) ? RET_OK : RET_ERROR;
+  } else if (token_equals(&tokens[1], "get")) {
+    command->config_op = CONFIG_OP_GET;
+    expected_tokens = 3;
+  } else if (token_equals(&tokens[1], "set")) {
+    command->config_op = CONFIG_OP_SET;
+    expected_tokens = 4;
+  } else {
+    return RET_ERROR;
+  }
+
+  if (num_tokens != expected_tokens) {
+    return RET_ERROR;
+  }
+
+  command->setting = setting_find(tokens[2].ptr, tokens[2].len);
+  if (command->setting == NULL) {
+    return RET_ERROR;
+  }
+
+  if (command->config_op == CONFIG_OP_SET) {
+    return command_parse_value(command, command->setting->type, &tokens[3]);
+  }
+  return RET_OK;
+}
+
+int command_generate(command_t *command, const char *buffer) {
+  token_t tokens[MAX_COMMAND_TOKENS];
+  size_t num_tokens = command_tokenize(buffer, tokens, MAX_COMMAND_TOKENS);
+
+  if (num_tokens == 0 || num_tokens > MAX_COMMAND_TOKENS) {
+    return RET_ERROR;
+  }
+
+  int index = lookup_find(&command_lookup, tokens[0].ptr, tokens[0].len);
+  if (index < 0) {
+    return RET_ERROR;
+  }
+  command->id = available_commands[index].id;
+  command->name = available_commands[index].name;
+  command->priority = available_commands[index].priority;
+
+  switch (command->id) {
+    case GET_PARAM:
+      if (num_tokens != 2) {
+        return RET_ERROR;
       }
+      break;
+    case SET_PARAM:
+      if (num_tokens != 3) {
+        return RET_ERROR;
+      }
+      break;
+    case TASK_CONTROL:
+      return command_parse_task(command, tokens, num_tokens);
+    case CONFIG:
+      return command_parse_config(command, tokens, num_tokens);
+    case GET_PARAMS:
+      // Text requests always read every parameter
+      command->param_mask = TELE_PARAM_MASK_ALL;
+      return (num_tokens == 1) ? RET_OK : RET_ERROR;
+    default:
+      return (num_tokens == 1) ? RET_OK : RET_ERROR;
+  }
 
-      // Set command parameters for parameterised commands
-      // int i;
-      // for(i = 0; i < part; i++){
-      //   memcpy(command->param[i], param_part[i], strlen(param_part[i]));
-      // }
+  command->tele_param = tele_param_find(tokens[1].ptr, tokens[1].len);
+  if (command->tele_param == NULL) {
+    return RET_ERROR;
+  }
 
-      // return true if matching command is found
-      return RET_OK;
+  if (command->id == SET_PARAM) {
+    return command_parse_value(command, command->tele_param->type, &tokens[2]);
+  }
+  return RET_OK;
+}
+
+int command_submit(thread_args_t *targs, const command_t *command) {
+  command_t *command_q;
+
+#ifdef TASK_SAFETY_COMMANDS
+  if (command->priority == COMMAND_PRIORITY_SAFETY) {
+    command_q = targs->safety_command_queue->alloc(0);
+    if (command_q == NULL) {
+      return RET_ERROR;
+    }
+    memcpy(command_q, command, sizeof(command_t));
+    targs->safety_command_queue->put(command_q);
+    return RET_OK;
+  }
+#endif
+
+  command_q = targs->command_queue->alloc(0);
+  if (command_q == NULL) {
+    return RET_ERROR;
+  }
+  memcpy(command_q, command, sizeof(command_t));
+  targs->command_queue->put(command_q);
+  return RET_OK;
+}
+
+bool command_allowed(const command_t *command) {
+  if (command->link == LINK_USB) {
+    return true;
+  }
+
+  if (command->link == LINK_USB_BINARY) {
+#ifndef USB_BINARY_ARMING
+    // Typed commands need someone at the keyboard, a frame only needs a program
+    if (command->id == PARTIAL_ARM || command->id == FULLY_ARM) {
+      return false;
     }
+#endif
+    return true;
   }
 
-  // Return false (0) if no match is found
-  return RET_ERROR;
+  switch (command->id) {
+    case STATUS:
+    case GET_PARAM:
+    case GET_PARAMS:
+    case SET_PARAM:
+      return true;
+    default:
+      return false;
+  }
+}
+
+/**
+* @brief Print a parameter value to the USB serial console.
+*/
+static void command_print_param(const tele_command_t *param, const tele_value_t *value) {
+  switch (param->type) {
+    case CT_INT:
+      LOG("\r%s %d %s\r\n", param->name, value->i, tele_command_unit_to_string(param->unit));
+      break;
+    case CT_FLOAT:
+      LOG("\r%s %.2f %s\r\n", param->name, value->f, tele_command_unit_to_string(param->unit));
+      break;
+    case CT_BOOLEAN:
+      LOG("\r%s %s\r\n", param->name, value->b ? "ON" : "OFF");
+      break;
+    default:
+      break;
+  }
+}
+
+/**
+* @brief Print a setting value to the USB serial console.
+*/
+static void command_print_setting(const setting_t *setting, const tele_value_t *value) {
+  if (setting->type == CT_FLOAT) {
+    LOG("\r%-18s %10.2f  [%.2f, %.2f]\r\n", setting->name, value->f, setting->min, setting->max);
+  } else {
+    LOG("\r%-18s %10d  [%d, %d]\r\n", setting->name, value->i, (int) setting->min, (int) setting->max);
+  }
+}
+
+void command_respond(const command_t *command, int err, thread_args_t *targs) {
+  switch (command->link) {
+#ifdef DEVICE_ESP8266
+    case LINK_ESP8266:
+      targs->mutex.esp_serial->lock();
+      link_send_response(targs->esp_serial, command, err, targs);
+      targs->mutex.esp_serial->unlock();
+      break;
+#endif
+    case LINK_USB_BINARY:
+      // Hold the port so log output can't land in the middle of a frame
+      targs->serial->acquire();
+      link_send_response(targs->serial, command, err, targs);
+      targs->serial->release();
+      break;
+    case LINK_USB:
+    default:
+      if (err != RET_OK) {
+        LOG("\rError: %s\r\n", err_to_str(err));
+        break;
+      }
+
+      if (command->id == GET_PARAM) {
+        command_print_param(command->tele_param, &command->value);
+        break;
+      }
+
+      if (command->id == CONFIG && command->config_op == CONFIG_OP_GET) {
+        command_print_setting(command->setting, &command->value);
+        break;
+      }
+
+      if (command->id == CONFIG && command->config_op == CONFIG_OP_LIST) {
+        break;
+      }
+
+      if (command->id == GET_PARAMS) {
+        unsigned i;
+        tele_value_t value;
+        for (i = 0; i < NUM_TELE_COMMANDS; i++) {
+          if (command->param_mask & TELE_PARAM_MASK(i)) {
+            targs->mutex.telemetry->lock();
+            value = tele_commands[i].param;
+            targs->mutex.telemetry->unlock();
+            command_print_param(&tele_commands[i], &value);
+          }
+        }
+        break;
+      }
+
+      LOG("\rCommand succesful\r\n");
+      break;
+  }
 }
 
 int command_execute(command_t *command, thread_args_t *targs) {
+  if (!command_allowed(command)) {
+    return RET_NOT_ALLOWED;
+  }
+
+  if ((command->id == GET_PARAM || command->id == SET_PARAM) && command->tele_param == NULL) {
+    return RET_ERROR;
+  }
+
   switch (command->id) {
     case FULLY_DISARM:
       return command_fully_disarm(command, targs);
@@ -158,65 +419,62 @@ int command_execute(command_t *command, thread_args_t *targs) {
     case CALIBRATE_CHANNELS:
       return command_calibrate_channels(command, targs);
 #endif  // TASK_CALIBRATE_CHANNELS
+    case TASK_CONTROL:
+      return command_task(command, targs);
+    case GET_PARAMS:
+      return command_get_params(command, targs);
+    case CONFIG:
+      return command_config(command, targs);
+    case MEMORY:
+      return command_memory(command, targs);
     default:
       return RET_ERROR;
   }
 }
 
 int command_fully_disarm(command_t *command, thread_args_t *targs) {
-  if (targs->state == STATE_DISARMED) {
+  if (!state_raise(&targs->state, STATE_EVENT_COMMAND_DISARM)) {
     return RET_ALREADY_DISARMED;
   }
-  targs->state = STATE_DISARMED;
   return RET_OK;
 }
 
 int command_partial_disarm(command_t *command, thread_args_t *targs) {
-  switch (targs->state) {
-    case STATE_DISARMED:
-      return RET_ALREADY_DISARMED;
-    case STATE_DRIVE_ONLY:
-      targs->state = STATE_DISARMED;
-      return RET_OK;
-    case STATE_WEAPON_ONLY:
-      targs->state = STATE_DRIVE_ONLY;
-      return RET_OK;
-    case STATE_FULLY_ARMED:
-      targs->state = STATE_WEAPON_ONLY;
-      return RET_OK;
-    default:
-      return RET_ERROR;
+  if (!state_raise(&targs->state, STATE_EVENT_COMMAND_PARTIAL_DISARM)) {
+    return RET_ALREADY_DISARMED;
   }
+  return RET_OK;
 }
 
 int command_partial_arm(command_t *command, thread_args_t *targs) {
-  switch (targs->state) {
-    case STATE_DISARMED:
-      targs->state = STATE_DRIVE_ONLY;
-      return RET_OK;
-    case STATE_DRIVE_ONLY:
-      targs->state = STATE_WEAPON_ONLY;
-      return RET_OK;
-    case STATE_WEAPON_ONLY:
-      targs->state = STATE_FULLY_ARMED;
-      return RET_OK;
-    case STATE_FULLY_ARMED:
-      return RET_ALREADY_ARMED;
-    default:
-      return RET_ERROR;
+  if (!state_raise(&targs->state, STATE_EVENT_COMMAND_PARTIAL_ARM)) {
+    return RET_ALREADY_ARMED;
   }
+  return RET_OK;
 }
 
 int command_fully_arm(command_t *command, thread_args_t *targs) {
-  if (targs->state == STATE_FULLY_ARMED) {
+  if (!state_raise(&targs->state, STATE_EVENT_COMMAND_ARM)) {
     return RET_ALREADY_ARMED;
   }
-  targs->state = STATE_FULLY_ARMED;
   return RET_OK;
 }
 
 int command_status(command_t *command, thread_args_t *targs) {
+  state_transition_t history[STATE_HISTORY_LEN];
+  unsigned n, i;
+
   LOG("\rStatus: %s\r\n", state_to_str(targs->state));
+  n = state_history(history, STATE_HISTORY_LEN);
+  LOG("\r(State) changes: %lu, newest first:\r\n", (unsigned long) state_transitions());
+  for (i = 0; i < n; i++) {
+    LOG("\r  %8lu ms  %-11s --> %-11s  (%s)\r\n",
+      (unsigned long) history[i].time_ms,
+      state_to_str(history[i].from),
+      state_to_str(history[i].to),
+      state_event_to_str(history[i].event)
+    );
+  }
   // LOG("\r(ESCS) D1: %d, D2: %d, D3: %d, W1: %d, W2: %d\r\n",
   //   targs->outputs.wheel_1,
   //   targs->outputs.wheel_2,
@@ -230,82 +488,313 @@ int command_status(command_t *command, thread_args_t *targs) {
     orientation_to_str(targs->orientation_detected),
     orientation_to_str(targs->orientation_override)
   );
-  LOG("\r              heading: %d, pitch: %d, roll: %d\r\n", targs->orientation.heading, targs->orientation.pitch, targs->orientation.roll);
+  LOG("\r              heading: %.1f, pitch: %.1f, roll: %.1f\r\n", targs->orientation.heading, targs->orientation.pitch, targs->orientation.roll);
+#ifdef TASK_FLIGHT_LOG
+  LOG("\r(Flight Log) written: %lu, lost: %lu, write errors: %lu, discarded: %lu, %s\r\n",
+    (unsigned long) targs->flight_log->blocks_written,
+    (unsigned long) targs->flight_log->lost_blocks,
+    (unsigned long) targs->flight_log->write_errors,
+    (unsigned long) targs->flight_log->discarded_blocks,
+    targs->flight_log->hold ? "held while armed" : "writing"
+  );
+#endif
+#if defined(DEVICE_ESP8266) && defined(TASK_PROCESS_COMMANDS)
+  LOG("\r(ESP8266 Link) frames: %lu, crc errors: %lu, dropped: %lu\r\n",
+    (unsigned long) link_esp8266_stats()->frames,
+    (unsigned long) link_esp8266_stats()->crc_errors,
+    (unsigned long) link_esp8266_stats()->dropped
+  );
+#endif
+#ifdef TASK_PROCESS_COMMANDS
+  LOG("\r(USB Link) frames: %lu, crc errors: %lu, dropped: %lu\r\n",
+    (unsigned long) link_usb_stats()->frames,
+    (unsigned long) link_usb_stats()->crc_errors,
+    (unsigned long) link_usb_stats()->dropped
+  );
+#endif
+#ifdef TASK_READ_SERIAL
+  LOG("\r(CLI) lines dropped: %lu, echo dropped: %lu\r\n",
+    (unsigned long) cli_overruns(),
+    (unsigned long) cli_echo_dropped()
+  );
+#endif
+  esc_cutoff_stats_t cutoff_stats;
+  esc_cutoff_get_stats(&cutoff_stats);
+  LOG("\r(Cutoff) count: %lu, worst detect: %lu us late, worst apply: %lu us, computed bound: %lu us\r\n",
+    (unsigned long) cutoff_stats.cutoffs,
+    (unsigned long) cutoff_stats.worst_detect_us,
+    (unsigned long) cutoff_stats.worst_apply_us,
+    (unsigned long) cutoff_stats.bound_us
+  );
+#ifdef TASK_LOG
+  log_queue_stats_t log_stats;
+  log_queue_get_stats(&log_stats);
+  LOG("\r(Log) written: %lu, dropped alert/console/debug: %lu/%lu/%lu, truncated: %lu\r\n",
+    (unsigned long) log_stats.written,
+    (unsigned long) log_stats.dropped[LOG_CHANNEL_ALERT],
+    (unsigned long) log_stats.dropped[LOG_CHANNEL_CONSOLE],
+    (unsigned long) log_stats.dropped[LOG_CHANNEL_DEBUG],
+    (unsigned long) log_stats.truncated
+  );
+#endif
   return RET_OK;
 }
 
 int command_get_param(command_t *command, thread_args_t *targs) {
-  LOG("Getting param\r\n");
-  switch (command->tele_param->id) {
-    case CID_DRIVE_RPM_1:
-    case CID_DRIVE_RPM_2:
-    case CID_DRIVE_RPM_3:
-    case CID_WEAPON_RPM_1:
-    case CID_WEAPON_RPM_2:
-    case CID_WEAPON_RPM_3:
-#ifdef DEVICE_BNO055
-    case CID_ACCEL_X:
-    case CID_ACCEL_Y:
-    case CID_ACCEL_Z:
-    case CID_PITCH:
-    case CID_ROLL:
-    case CID_YAW:
-    case CID_AMBIENT_TEMP:
-#endif
-    case CID_WEAPON_VOLTAGE_1:
-    case CID_WEAPON_VOLTAGE_2:
-    case CID_WEAPON_VOLTAGE_3:
-    case CID_DRIVE_VOLTAGE_1:
-    case CID_DRIVE_VOLTAGE_2:
-    case CID_DRIVE_VOLTAGE_3:
-    case CID_ARM_STATUS:
-      printf(
-        "%s %s\r\n",
-        tele_commands[command->tele_param->id].name,
-        state_to_str(targs->state));
-      break;
+  targs->mutex.telemetry->lock();
+  command->value = command->tele_param->param;
+  targs->mutex.telemetry->unlock();
+  return RET_OK;
+}
+
+int command_get_params(command_t *command, thread_args_t *targs) {
+  if (command->param_mask == 0 || (command->param_mask & ~TELE_PARAM_MASK_ALL) != 0) {
+    return RET_ERROR;
   }
   return RET_OK;
 }
+
 int command_set_param(command_t *command, thread_args_t *targs) {
-  LOG("Setting param\r\n");
-  switch (command->tele_param->id) {
-    case CID_DRIVE_RPM_1:
-    case CID_DRIVE_RPM_2:
-    case CID_DRIVE_RPM_3:
-    case CID_WEAPON_RPM_1:
-    case CID_WEAPON_RPM_2:
-    case CID_WEAPON_RPM_3:
-#ifdef DEVICE_BNO055
-    case CID_ACCEL_X:
-    case CID_ACCEL_Y:
-    case CID_ACCEL_Z:
-    case CID_PITCH:
-    case CID_ROLL:
-    case CID_YAW:
-    case CID_AMBIENT_TEMP:
-      tele_commands[command->tele_param->id].param.f = command->value.f;
-      break;
-#endif
-    case CID_WEAPON_VOLTAGE_1:
-    case CID_WEAPON_VOLTAGE_2:
-    case CID_WEAPON_VOLTAGE_3:
-    case CID_DRIVE_VOLTAGE_1:
-    case CID_DRIVE_VOLTAGE_2:
-    case CID_DRIVE_VOLTAGE_3:
-    case CID_ARM_STATUS:
-      printf("Use arming commands to set arm_state!\r\n");
-      return RET_ERROR;
+  tele_command_t *param = command->tele_param;
+
+  if (param->set == NULL) {
+    return RET_READ_ONLY;
   }
-  return RET_OK;
+  return param->set(targs, &command->value);
 }
+
 #ifdef TASK_CALIBRATE_CHANNELS
 int command_calibrate_channels(command_t *command, thread_args_t *targs) {
   if (targs->state != STATE_DISARMED) {
     return RET_DISARM_FIRST;
   }
 
-  targs->tasks[TASK_CALIBRATE_CHANNELS_ID].active = true;
+  // Wakes the parked calibration task
+  task_set_active(targs, TASK_CALIBRATE_CHANNELS_ID, true);
   return RET_OK;
 }
 #endif  // TASK_CALIBRATE_CHANNELS
+
+/**
+* @brief Print every task with the statistics gathered since the last list.
+*/
+static void command_task_list(thread_args_t *targs) {
+  // Statistics cover the time since the previous list (or boot)
+  static uint32_t last_list_us = 0;
+  static uint32_t last_switches = 0;
+  uint32_t now_us = us_ticker_read();
+  uint32_t window_us = now_us - last_list_us;
+  last_list_us = now_us;
+  uint32_t switches = task_context_switches();
+  uint32_t window_switches = switches - last_switches;
+  last_switches = switches;
+
+  uint64_t window_cycles = (uint64_t) window_us * (SystemCoreClock / 1000000);
+  task_stats_t stats;
+  unsigned t;
+
+  LOG("\rID Name               On  Prio  Period  Rate(Hz)  CPU(%%)  Max(us)  Jitter(us)  WCRT(us)  Miss  Last(ms)  Stack used/free\r\n");
+  for (t = 0; t < NUM_TASKS; t++) {
+    task_stats_take(&targs->tasks[t], &stats);
+
+    // CPU share in tenths of a percent
+    unsigned cpu = (window_cycles > 0) ? (unsigned) (((uint64_t) stats.busy_cycles * 1000) / window_cycles) : 0;
+    unsigned rate = (window_us > 0) ? (unsigned) (((uint64_t) stats.iterations * 1000000) / window_us) : 0;
+    unsigned max_us = stats.max_cycles / (SystemCoreClock / 1000000);
+
+    LOG("\r%-2d %-18s %-3s %4d  %6lu  %8d  %3d.%d  %7d  %10lu  %8lu  %4lu  ",
+      t,
+      targs->tasks[t].name,
+      targs->tasks[t].active ? "Yes" : "No",
+      targs->tasks[t].priority,
+      (unsigned long) targs->tasks[t].period_ms,
+      rate,
+      cpu / 10, cpu % 10,
+      max_us,
+      (unsigned long) stats.worst_jitter_us,
+      (unsigned long) stats.worst_response_us,
+      (unsigned long) stats.deadline_misses
+    );
+    if (stats.has_run) {
+      LOG("%8lu  ", (unsigned long) ((now_us - stats.last_run_us) / 1000));
+    } else {
+      LOG("%8s  ", "never");
+    }
+    if (targs->tasks[t].func == NULL) {
+      LOG("%s\r\n", "(events)");
+      continue;
+    }
+    LOG("%5lu/%lu\r\n", (unsigned long) targs->threads[t].used_stack(), (unsigned long) targs->threads[t].free_stack());
+  }
+
+  if (switches == 0) {
+    LOG("\rContext switches: not counted, RTX thread switch hook is compiled out\r\n");
+  } else if (window_us > 0) {
+    LOG("\rContext switches: %d/s\r\n", (unsigned) (((uint64_t) window_switches * 1000000) / window_us));
+  }
+}
+
+/**
+* @brief Print the stack high water mark of every task and a size to use.
+*/
+static void command_task_stack(thread_args_t *targs) {
+  unsigned t;
+  uint32_t total_size = 0;
+  uint32_t total_recommended = 0;
+
+  LOG("\rID Name               Size  Peak  Recommended\r\n");
+  for (t = 0; t < NUM_TASKS; t++) {
+    const task_t *task = &targs->tasks[t];
+    task_stack_sample(targs, t);
+    LOG("\r%-2d %-18s %4lu  %4lu  %11lu  %s\r\n",
+      t,
+      task->name,
+      (unsigned long) task->stack_size,
+      (unsigned long) task->stack_peak,
+      (unsigned long) task_stack_recommended(task),
+      task_stack_low(task) ? "LOW" : ""
+    );
+    total_size += task->stack_size;
+    total_recommended += task_stack_recommended(task);
+  }
+  LOG("\r%-21s %4lu  %4s  %11lu\r\n", "Total", (unsigned long) total_size, "", (unsigned long) total_recommended);
+}
+
+/**
+* @brief Rank the periodic tasks again after a change of rate.
+*/
+static void command_task_reprioritise(thread_args_t *targs) {
+  unsigned t;
+  task_assign_priorities(targs->tasks, NUM_TASKS);
+  for (t = 0; t < NUM_TASKS; t++) {
+    if (targs->tasks[t].func == NULL) {
+      continue;
+    }
+    if (targs->threads[t].get_priority() != targs->tasks[t].priority) {
+      targs->threads[t].set_priority(targs->tasks[t].priority);
+    }
+  }
+}
+
+int command_task(command_t *command, thread_args_t *targs) {
+  task_t *task;
+
+  // Only stop, start and rate name a task, list and stack leave task_id unset
+  switch (command->task_op) {
+    case TASK_OP_LIST:
+      command_task_list(targs);
+      return RET_OK;
+    case TASK_OP_STACK:
+      command_task_stack(targs);
+      return RET_OK;
+    case TASK_OP_STOP:
+      if (command->task_id >= NUM_TASKS) {
+        return RET_ERROR;
+      }
+      if (!task_stoppable(command->task_id)) {
+        return RET_NOT_ALLOWED;
+      }
+      if (task_gates_outputs(command->task_id) && targs->state != STATE_DISARMED) {
+        return RET_DISARM_FIRST;
+      }
+      task_set_active(targs, command->task_id, false);
+      return RET_OK;
+    case TASK_OP_START:
+      if (command->task_id >= NUM_TASKS) {
+        return RET_ERROR;
+      }
+      if (task_gates_outputs(command->task_id) && targs->state != STATE_DISARMED) {
+        return RET_DISARM_FIRST;
+      }
+      task_set_active(targs, command->task_id, true);
+      return RET_OK;
+    case TASK_OP_RATE:
+      if (command->task_id >= NUM_TASKS) {
+        return RET_ERROR;
+      }
+      task = &targs->tasks[command->task_id];
+      // Tasks woken by an event have no rate to change
+      if (task->period_ms == 0) {
+        return RET_NOT_ALLOWED;
+      }
+#ifdef TASK_EXECUTIVE
+      // The executive's frame is fixed by its timer, its slots count frames
+      if (command->task_id == TASK_EXECUTIVE_ID) {
+        return RET_NOT_ALLOWED;
+      }
+#endif
+      task->period_ms = 1000 / command->value.i;
+#ifdef TASK_EVENTS
+      if (task->step != NULL) {
+        // Queued tasks take the new period when they are scheduled again
+        task_events_schedule(command->task_id);
+        return RET_OK;
+      }
+#endif
+      command_task_reprioritise(targs);
+      return RET_OK;
+    default:
+      return RET_ERROR;
+  }
+}
+
+int command_memory(command_t *command, thread_args_t *targs) {
+  mem_stats_t stats;
+  unsigned t;
+
+  // Sample now rather than waiting for the stack monitor
+  for (t = 0; t < NUM_TASKS; t++) {
+    task_stack_sample(targs, t);
+  }
+  mem_stats_sample(targs);
+  mem_stats_get(&stats);
+
+  LOG("\r(Heap) used: %lu, peak: %lu, reserved: %lu, allocations: %lu, failed: %lu\r\n",
+    (unsigned long) stats.heap_current,
+    (unsigned long) stats.heap_peak,
+    (unsigned long) stats.heap_reserved,
+    (unsigned long) stats.alloc_count,
+    (unsigned long) stats.alloc_failures
+  );
+  LOG("\r(ISR Stack) peak: %lu of %lu\r\n", (unsigned long) stats.isr_stack_peak, (unsigned long) stats.isr_stack_size);
+
+  LOG("\rID Name               Peak  Size  Used(%%)\r\n");
+  for (t = 0; t < NUM_TASKS; t++) {
+    // Queued tasks share the events task's stack
+    if (targs->tasks[t].stack_size == 0) {
+      continue;
+    }
+    LOG("\r%-2d %-18s %4lu  %4lu  %7lu\r\n",
+      t,
+      targs->tasks[t].name,
+      (unsigned long) targs->tasks[t].stack_peak,
+      (unsigned long) targs->tasks[t].stack_size,
+      (unsigned long) ((targs->tasks[t].stack_peak * 100) / targs->tasks[t].stack_size)
+    );
+  }
+  return RET_OK;
+}
+
+int command_config(command_t *command, thread_args_t *targs) {
+  switch (command->config_op) {
+    case CONFIG_OP_LIST: {
+      unsigned i;
+      tele_value_t value;
+      for (i = 0; i < NUM_SETTINGS; i++) {
+        setting_value(setting_get(i), &value);
+        command_print_setting(setting_get(i), &value);
+      }
+      return RET_OK;
+    }
+    case CONFIG_OP_GET:
+      setting_value(command->setting, &command->value);
+      return RET_OK;
+    case CONFIG_OP_SET:
+      if (setting_needs_disarm(command->setting) && targs->state != STATE_DISARMED) {
+        return RET_DISARM_FIRST;
+      }
+      return setting_set(command->setting, &command->value);
+    default:
+      return RET_ERROR;
+  }
+}
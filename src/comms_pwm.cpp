@@ -48,12 +48,12 @@ volatile comms_impl_t comms_impl_pwm = {
 * @brief Initialise static vector array of ESCs, one for each motor.
 */
 void comms_impl_pwm_init_comms(void) {
-  pwm_esc_array.push_back(ESC(DRIVE_ESC_OUT_1_PIN, 20, 1500));
-  pwm_esc_array.push_back(ESC(DRIVE_ESC_OUT_2_PIN, 20, 1500));
-  pwm_esc_array.push_back(ESC(DRIVE_ESC_OUT_3_PIN, 20, 1500));
-  pwm_esc_array.push_back(ESC(WEAPON_ESC_OUT_1_PIN));
-  pwm_esc_array.push_back(ESC(WEAPON_ESC_OUT_2_PIN));
-  pwm_esc_array.push_back(ESC(WEAPON_ESC_OUT_3_PIN));
+  pwm_esc_array.push_back(ESC(DRIVE_ESC_OUT_1_PIN, ESC_PWM_PERIOD_US / 1000, DRIVE_ESC_STOP_US));
+  pwm_esc_array.push_back(ESC(DRIVE_ESC_OUT_2_PIN, ESC_PWM_PERIOD_US / 1000, DRIVE_ESC_STOP_US));
+  pwm_esc_array.push_back(ESC(DRIVE_ESC_OUT_3_PIN, ESC_PWM_PERIOD_US / 1000, DRIVE_ESC_STOP_US));
+  pwm_esc_array.push_back(ESC(WEAPON_ESC_OUT_1_PIN, ESC_PWM_PERIOD_US / 1000, WEAPON_ESC_STOP_US));
+  pwm_esc_array.push_back(ESC(WEAPON_ESC_OUT_2_PIN, ESC_PWM_PERIOD_US / 1000, WEAPON_ESC_STOP_US));
+  pwm_esc_array.push_back(ESC(WEAPON_ESC_OUT_3_PIN, ESC_PWM_PERIOD_US / 1000, WEAPON_ESC_STOP_US));
 }
 
 
@@ -26,6 +26,11 @@
 #include "config.h"
 #include "thread_args.h"
 #include "tmath.h"
+#include "utils.h"
+#include "settings.h"
+#include "weapon_rpm.h"
+#include "state_outputs.h"
+#include "esc_cutoff.h"
 
 void drive_3_wheel_holonomic(const void * targs) {
   thread_args_t *args = (thread_args_t*) targs;
@@ -146,3 +151,135 @@ void weapon_manual_throttle(const void * targs) {
   args->outputs.weapon_motor_3 = weapon_ctrl_val;
   args->mutex.outputs->unlock();
 }
+
+/* RPM hold works in Q16.16 fixed point, throttle in % */
+#define Q16(x) ((int32_t) ((x) * 65536))
+#define WEAPON_THROTTLE_MAX Q16(100)
+
+/**
+ * Controller state of one weapon motor in RPM hold mode.
+ */
+typedef struct {
+  /*! Target RPM, ramped towards the stick setpoint. */
+  int32_t target_rpm;
+  /*! Integral term (Q16 %). */
+  int32_t integral;
+  /*! Throttle sent last tick (Q16 %). */
+  int32_t throttle;
+  /*! Set once the tachometer reads above the spin-up RPM, cleared if it
+      stops reading. */
+  bool spun_up;
+} weapon_rpm_hold_t;
+
+static weapon_rpm_hold_t weapon_hold[WEAPON_RPM_MOTORS];
+
+static int32_t clamp_q16(int32_t value, int32_t min, int32_t max) {
+  return MAX(MIN(value, max), min);
+}
+
+/**
+* @brief Move a value towards a target by no more than step.
+*/
+static int32_t slew(int32_t value, int32_t target, int32_t step) {
+  if (target > value + step) {
+    return value + step;
+  }
+  if (target < value - step) {
+    return value - step;
+  }
+  return target;
+}
+
+/**
+* @brief One control loop tick of one weapon motor.
+* @param [in/out] hold Controller state.
+* @param [in] setpoint_rpm RPM asked for by the stick.
+* @param [in] rpm Measured RPM, 0 if the tachometer has timed out.
+* @param [in] sensed The motor has a tachometer, else it is never run closed loop.
+* @param [in] s Settings.
+* @return Throttle (Q16 %).
+*/
+static int32_t weapon_rpm_hold_tick(weapon_rpm_hold_t *hold, int32_t setpoint_rpm,
+    int32_t rpm, bool sensed, const settings_t *s) {
+  /* The target follows the stick at no more than weapon_rpm_ramp, which
+     sets the spin-up (and spin-down) profile. */
+  int32_t ramp_step = s->weapon_rpm_ramp * CONTROL_LOOP_PERIOD_MS / 1000;
+  hold->target_rpm = slew(hold->target_rpm, setpoint_rpm, MAX(ramp_step, 1));
+
+  // Feed forward the throttle that would give the target open loop
+  int32_t feed_forward = (int64_t) hold->target_rpm * WEAPON_THROTTLE_MAX / s->weapon_rpm_max;
+  int32_t throttle;
+
+  /* A spun up motor that reads 0 has lost its tachometer signal (a broken
+     wire, or no pulse for WEAPON_TACHO_TIMEOUT_MS). Closing the loop on that
+     would drive it to full throttle, so fall back to open loop until the
+     tachometer reads above the spin-up RPM again. */
+  if (hold->spun_up && rpm <= 0) {
+    hold->spun_up = false;
+  }
+
+  if (!sensed || (!hold->spun_up && rpm < s->weapon_spinup_rpm)) {
+    // Open loop until the tachometer can be trusted
+    hold->integral = 0;
+    throttle = feed_forward;
+  } else {
+    hold->spun_up = true;
+
+    int32_t error = hold->target_rpm - rpm;
+    int32_t kp = Q16(s->weapon_rpm_kp / 1000.0f);
+    int32_t ki = Q16(s->weapon_rpm_ki / 1000.0f);
+    int32_t proportional = (int64_t) kp * error;
+    throttle = feed_forward + proportional + hold->integral;
+
+    /* Only integrate while it can still change the output, so the integral
+       does not wind up against full or zero throttle. */
+    bool saturated = (throttle >= WEAPON_THROTTLE_MAX && error > 0) || (throttle <= 0 && error < 0);
+    if (!saturated) {
+      hold->integral += (int64_t) ki * error * CONTROL_LOOP_PERIOD_MS / 1000;
+      hold->integral = clamp_q16(hold->integral, -WEAPON_THROTTLE_MAX, WEAPON_THROTTLE_MAX);
+    }
+  }
+
+  throttle = clamp_q16(throttle, 0, WEAPON_THROTTLE_MAX);
+
+  // Limit the rate of change, so a step in target doesn't pull a current spike
+  hold->throttle = slew(hold->throttle, throttle, Q16(WEAPON_THROTTLE_SLEW) * CONTROL_LOOP_PERIOD_MS / 1000);
+  return hold->throttle;
+}
+
+void weapon_rpm_hold(const void * targs) {
+  thread_args_t *args = (thread_args_t*) targs;
+  settings_t s;
+  float stick;
+  int throttle[WEAPON_RPM_MOTORS];
+  unsigned m;
+
+  settings_read(&s);
+
+  args->mutex.controls->lock();
+  stick = args->controls[0].channel[RC_0_THROTTLE];
+  args->mutex.controls->unlock();
+
+  /* Start again from standstill whenever the weapon cannot be driven, so
+     that it is spun up with the full profile when re-armed. */
+  bool driven = (args->esc_gate & ~esc_cutoff_outputs() & ESC_GATE_WEAPON) != 0;
+
+  int32_t setpoint_rpm = stick * s.weapon_rpm_max / 100.0f;
+  for (m = 0; m < WEAPON_RPM_MOTORS; m++) {
+    weapon_rpm_hold_t *hold = &weapon_hold[m];
+    // Stick at zero always stops the weapon, without ramping down
+    if (!driven || setpoint_rpm <= 0) {
+      memset(hold, 0x00, sizeof(weapon_rpm_hold_t));
+      throttle[m] = 0;
+      continue;
+    }
+    // Round to the nearest whole percent
+    throttle[m] = (weapon_rpm_hold_tick(hold, setpoint_rpm, weapon_rpm_read(m), weapon_rpm_sensed(m), &s) + Q16(0.5)) >> 16;
+  }
+
+  args->mutex.outputs->lock();
+  args->outputs.weapon_motor_1 = throttle[0];
+  args->outputs.weapon_motor_2 = throttle[1];
+  args->outputs.weapon_motor_3 = throttle[2];
+  args->mutex.outputs->unlock();
+}
@@ -0,0 +1,214 @@
+/* Copyright (c) 2018 Cameron A. Craig, MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ * BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * @file esc_cutoff.cpp
+ * @author Cameron A. Craig
+ * @date 24 Mar 2018
+ * @copyright 2018 Cameron A. Craig
+ * @brief Stops the ESCs of a stalled receiver from a timer interrupt, ahead of the failsafe task.
+ */
+
+#include "mbed.h"
+#include "esc_cutoff.h"
+#include "state_outputs.h"
+#include "states.h"
+#include "settings.h"
+#include "utils.h"
+
+static thread_args_t *cutoff_args = NULL;
+static Ticker cutoff_timer;
+
+static volatile int cutoff_timeout_us = 0;
+/* ESC_GATE_* bits held stopped, only written by the interrupt */
+static volatile uint32_t cutoff_held = 0;
+
+static volatile uint32_t cutoff_count = 0;
+static volatile uint32_t cutoff_worst_detect_us = 0;
+static volatile uint32_t cutoff_worst_apply_us = 0;
+
+/* Match register, latch bit and stopped pulse of each ESC output
+   (COMMS_OUTPUT_*), written directly so the interrupt does not depend on
+   the ESC driver. A NULL register falls back to comms_impl->stop(). */
+static __IO uint32_t *cutoff_match[6];
+static uint32_t cutoff_latch[6];
+static uint32_t cutoff_ticks[6];
+
+/**
+* @brief PWM1 channel of a pin, 0 if it is not one of the mbed PWM pins.
+*/
+static unsigned cutoff_pwm_channel(PinName pin) {
+  switch (pin) {
+    case p21: return 6;
+    case p22: return 5;
+    case p23: return 4;
+    case p24: return 3;
+    case p25: return 2;
+    case p26: return 1;
+    default: return 0;
+  }
+}
+
+static __IO uint32_t *cutoff_match_register(unsigned channel) {
+  switch (channel) {
+    case 1: return &LPC_PWM1->MR1;
+    case 2: return &LPC_PWM1->MR2;
+    case 3: return &LPC_PWM1->MR3;
+    case 4: return &LPC_PWM1->MR4;
+    case 5: return &LPC_PWM1->MR5;
+    case 6: return &LPC_PWM1->MR6;
+    default: return NULL;
+  }
+}
+
+/**
+* @brief Work out the register writes for each output.
+* @details MR0 holds the shared PWM period in timer ticks, as set up by the
+*          ESC driver, so the stopped pulses are scaled from it.
+*/
+static void cutoff_registers_init(void) {
+  static const PinName pins[6] = {
+    DRIVE_ESC_OUT_1_PIN, DRIVE_ESC_OUT_2_PIN, DRIVE_ESC_OUT_3_PIN,
+    WEAPON_ESC_OUT_1_PIN, WEAPON_ESC_OUT_2_PIN, WEAPON_ESC_OUT_3_PIN
+  };
+  static const uint32_t stop_us[6] = {
+    DRIVE_ESC_STOP_US, DRIVE_ESC_STOP_US, DRIVE_ESC_STOP_US,
+    WEAPON_ESC_STOP_US, WEAPON_ESC_STOP_US, WEAPON_ESC_STOP_US
+  };
+  unsigned i;
+
+  for (i = 0; i < 6; i++) {
+    unsigned channel = cutoff_pwm_channel(pins[i]);
+    cutoff_match[i] = cutoff_match_register(channel);
+    cutoff_latch[i] = 1U << channel;
+    cutoff_ticks[i] = (uint64_t) LPC_PWM1->MR0 * stop_us[i] / ESC_PWM_PERIOD_US;
+  }
+}
+
+/**
+* @brief Write the stopped pulse to the match registers of some outputs.
+* @details The match registers take the new pulse width at the start of the
+*          next PWM period, so a pulse already being sent is never cut short.
+* @param [in] outputs ESC_GATE_* bits.
+* @return The outputs with no match register.
+*/
+static uint32_t cutoff_write_registers(uint32_t outputs) {
+  uint32_t latch = 0;
+  uint32_t fallback = 0;
+  unsigned i;
+  for (i = 0; i < 6; i++) {
+    if (!(outputs & (1U << i))) {
+      continue;
+    }
+    if (cutoff_match[i] == NULL) {
+      fallback |= 1U << i;
+      continue;
+    }
+    *cutoff_match[i] = cutoff_ticks[i];
+    latch |= cutoff_latch[i];
+  }
+  LPC_PWM1->LER |= latch;
+  return fallback;
+}
+
+/**
+* @brief Put the stopped pulse on some outputs.
+* @param [in] outputs ESC_GATE_* bits.
+*/
+static void cutoff_apply(uint32_t outputs) {
+  uint32_t fallback = cutoff_write_registers(outputs);
+  if (fallback) {
+    esc_gate_stop(cutoff_args, fallback);
+  }
+}
+
+/**
+* @brief Hold or release one receiver's outputs.
+* @details Applying a hold also raises the stall event, so the state, LEDs
+*          and telemetry show the disarm even if the failsafe task, which
+*          polls less often, never sees the stall.
+* @param [in] outputs ESC_GATE_* bits driven by the receiver.
+* @param [in] channel Receiver channel watched for a stall.
+* @param [in] event Stall event of the receiver.
+*/
+static void cutoff_check(uint32_t outputs, PwmIn *channel, state_event_t event) {
+  int stall_us = channel->stallTimer.read_us();
+  // A negative time has overflowed, see is_drive_stalled()
+  bool stalled = (stall_us > cutoff_timeout_us) || (stall_us < 0);
+
+  if (stalled) {
+    // Already stopped if disarmed, nothing to do
+    if ((cutoff_held & outputs) || !(cutoff_args->esc_gate & outputs)) {
+      return;
+    }
+    uint32_t start = us_ticker_read();
+    cutoff_held |= outputs;
+    cutoff_apply(outputs);
+    uint32_t apply_us = us_ticker_read() - start;
+
+    cutoff_count++;
+    if (stall_us > 0 && (uint32_t) (stall_us - cutoff_timeout_us) > cutoff_worst_detect_us) {
+      cutoff_worst_detect_us = stall_us - cutoff_timeout_us;
+    }
+    if (apply_us > cutoff_worst_apply_us) {
+      cutoff_worst_apply_us = apply_us;
+    }
+
+    state_raise(&cutoff_args->state, event);
+  } else if ((cutoff_held & outputs) && !(cutoff_args->esc_gate & outputs)) {
+    cutoff_held &= ~outputs;
+  }
+}
+
+/**
+* @brief Cutoff timer interrupt.
+*/
+static void cutoff_tick(void) {
+  cutoff_check(ESC_GATE_DRIVE, drive_stall_channel(cutoff_args), STATE_EVENT_DRIVE_STALL);
+  cutoff_check(ESC_GATE_WEAPON, weapon_stall_channel(cutoff_args), STATE_EVENT_WEAPON_STALL);
+
+  /* The ESC driver sets its own latch bits with a read-modify-write of LER
+     from thread context, which can write back a 0 over one set here. Set
+     them again every tick while held, so a lost bit costs at most a tick. */
+  if (cutoff_held) {
+    cutoff_write_registers(cutoff_held);
+  }
+}
+
+void esc_cutoff_init(thread_args_t *args) {
+  settings_t s;
+  settings_read(&s);
+
+  cutoff_args = args;
+  esc_cutoff_set_timeout(s.stall_timeout_ms);
+  cutoff_registers_init();
+  cutoff_timer.attach_us(&cutoff_tick, ESC_CUTOFF_TICK_US);
+}
+
+void esc_cutoff_set_timeout(int timeout_ms) {
+  cutoff_timeout_us = timeout_ms * 1000;
+}
+
+uint32_t esc_cutoff_outputs(void) {
+  return cutoff_held;
+}
+
+void esc_cutoff_get_stats(esc_cutoff_stats_t *stats) {
+  stats->cutoffs = cutoff_count;
+  stats->worst_detect_us = cutoff_worst_detect_us;
+  stats->worst_apply_us = cutoff_worst_apply_us;
+  stats->bound_us = cutoff_timeout_us + 2 * ESC_CUTOFF_TICK_US + ESC_PWM_PERIOD_US;
+}
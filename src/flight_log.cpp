@@ -0,0 +1,111 @@
+/* Copyright (c) 2018 Cameron A. Craig, MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ * BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * @file flight_log.cpp
+ * @author Cameron A. Craig
+ * @date 10 Feb 2018
+ * @copyright 2018 Cameron A. Craig
+ * @brief Double-buffered binary flight recorder, written to LocalFileSystem.
+ */
+
+#include "mbed.h"
+#include "flight_log.h"
+
+void flight_log_init(flight_log_t *log) {
+  memset(log, 0x00, sizeof(flight_log_t));
+  log->writing = -1;
+}
+
+void flight_log_hold(flight_log_t *log, bool hold) {
+  log->hold = hold;
+  if (!hold && log->writer != NULL) {
+    log->writer->signal_set(FLIGHT_LOG_SIGNAL);
+  }
+}
+
+void flight_log_append(flight_log_t *log, const flight_log_record_t *record) {
+  flight_log_block_t *block = &log->block[log->fill];
+
+  memcpy(&block->records[block->header.record_count], record, sizeof(flight_log_record_t));
+  block->header.record_count++;
+
+  if (block->header.record_count < FLIGHT_LOG_RECORDS_PER_BLOCK) {
+    return;
+  }
+
+  uint32_t next = (log->fill + 1) % FLIGHT_LOG_BLOCKS;
+  if (log->ready[next]) {
+    log->lost_blocks++;
+    if (log->writing == (int) next) {
+      // Being written, drop this block and start filling it again
+      block->header.record_count = 0;
+      return;
+    }
+    // Writer hasn't caught up (or is held), keep the newest and lose the oldest
+    log->ready[next] = false;
+  }
+
+  block->header.magic = FLIGHT_LOG_MAGIC;
+  block->header.sequence = log->sequence++;
+  block->header.record_size = sizeof(flight_log_record_t);
+  block->header.lost_blocks = log->lost_blocks;
+  log->ready[log->fill] = true;
+
+  log->block[next].header.record_count = 0;
+  log->fill = next;
+
+  if (log->writer != NULL) {
+    log->writer->signal_set(FLIGHT_LOG_SIGNAL);
+  }
+}
+
+void flight_log_flush(flight_log_t *log, FILE *file) {
+  uint32_t fill = log->fill;
+  uint32_t n;
+  // Oldest first, starting after the block being filled
+  for (n = 1; n <= FLIGHT_LOG_BLOCKS; n++) {
+    uint32_t i = (fill + n) % FLIGHT_LOG_BLOCKS;
+    if (file != NULL && log->hold) {
+      break;
+    }
+
+    /* Claim the block before checking it, the control loop runs at a higher
+       priority and may overwrite any block that is not claimed. */
+    log->writing = i;
+    __DMB();
+    if (!log->ready[i]) {
+      log->writing = -1;
+      continue;
+    }
+
+    if (file == NULL) {
+      log->discarded_blocks++;
+    } else if (fwrite(&log->block[i], sizeof(flight_log_block_t), 1, file) == 1) {
+      log->blocks_written++;
+    } else {
+      log->write_errors++;
+    }
+
+    // Hand the block back to the control loop
+    log->ready[i] = false;
+    log->writing = -1;
+  }
+
+  if (file != NULL && !log->hold) {
+    fflush(file);
+  }
+}
@@ -0,0 +1,316 @@
+/* Copyright (c) 2018 Cameron A. Craig, MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ * BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * @file link.cpp
+ * @author Cameron A. Craig
+ * @date 17 Feb 2018
+ * @copyright 2018 Cameron A. Craig
+ * @brief Framed binary command links (e.g. ESP8266) and the command response routing.
+ */
+
+#include "mbed.h"
+#include "link.h"
+#include "commands.h"
+#include "tele_params.h"
+#include "return_codes.h"
+#include "tasks.h"
+
+void link_parser_reset(link_parser_t *parser) {
+  parser->state = LINK_WAIT_SYNC;
+  parser->len = 0;
+  parser->pos = 0;
+  parser->crc = 0;
+}
+
+uint8_t link_crc8(uint8_t crc, uint8_t byte) {
+  int bit;
+  crc ^= byte;
+  for (bit = 0; bit < 8; bit++) {
+    crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : (crc << 1);
+  }
+  return crc;
+}
+
+bool link_parser_feed(link_parser_t *parser, uint8_t byte) {
+  switch (parser->state) {
+    case LINK_WAIT_SYNC:
+      if (byte == LINK_SYNC) {
+        parser->state = LINK_WAIT_LEN;
+      }
+      return false;
+    case LINK_WAIT_LEN:
+      if (byte == 0 || byte > LINK_MAX_PAYLOAD) {
+        link_parser_reset(parser);
+        return false;
+      }
+      parser->len = byte;
+      parser->pos = 0;
+      parser->crc = link_crc8(0, byte);
+      parser->state = LINK_WAIT_PAYLOAD;
+      return false;
+    case LINK_WAIT_PAYLOAD:
+      parser->payload[parser->pos++] = byte;
+      parser->crc = link_crc8(parser->crc, byte);
+      if (parser->pos == parser->len) {
+        parser->state = LINK_WAIT_CRC;
+      }
+      return false;
+    case LINK_WAIT_CRC:
+    default:
+      parser->state = LINK_WAIT_SYNC;
+      return byte == parser->crc;
+  }
+}
+
+void link_send_frame(RawSerial *serial, const uint8_t *payload, uint8_t len) {
+  uint8_t crc = link_crc8(0, len);
+  uint8_t i;
+
+  serial->putc(LINK_SYNC);
+  serial->putc(len);
+  for (i = 0; i < len; i++) {
+    serial->putc(payload[i]);
+    crc = link_crc8(crc, payload[i]);
+  }
+  serial->putc(crc);
+}
+
+int link_decode_command(const uint8_t *payload, uint8_t len, command_t *command) {
+  if (len < 2 || payload[1] >= NUM_COMMANDS) {
+    return RET_ERROR;
+  }
+
+  command->seq = payload[0];
+  command->id = available_commands[payload[1]].id;
+  command->name = available_commands[payload[1]].name;
+  command->priority = available_commands[payload[1]].priority;
+  command->tele_param = NULL;
+  command->value.i = 0;
+
+  if (command->id == GET_PARAM || command->id == SET_PARAM) {
+    if (len < 3 || (command->tele_param = tele_param_get(payload[2])) == NULL) {
+      return RET_ERROR;
+    }
+  }
+
+  if (command->id == TASK_CONTROL) {
+    if (len < 4 || payload[2] > TASK_OP_STACK || payload[3] >= NUM_TASKS) {
+      return RET_ERROR;
+    }
+    command->task_op = (task_op_t) payload[2];
+    command->task_id = payload[3];
+    if (command->task_op == TASK_OP_RATE) {
+      if (len < 6) {
+        return RET_ERROR;
+      }
+      command->value.i = payload[4] | (payload[5] << 8);
+      if (command->value.i < 1 || command->value.i > 1000) {
+        return RET_ERROR;
+      }
+    }
+  }
+
+  if (command->id == CONFIG) {
+    // cfg list prints text, so is only offered on the command line
+    if (len < 4 || payload[2] == CONFIG_OP_LIST || payload[2] > CONFIG_OP_SET ||
+        (command->setting = setting_get(payload[3])) == NULL) {
+      return RET_ERROR;
+    }
+    command->config_op = (config_op_t) payload[2];
+    if (command->config_op == CONFIG_OP_SET) {
+      if (len < 8) {
+        return RET_ERROR;
+      }
+      uint32_t raw = payload[4] | (payload[5] << 8) | (payload[6] << 16) | (payload[7] << 24);
+      memcpy(&command->value, &raw, sizeof(raw));
+    }
+  }
+
+  if (command->id == GET_PARAMS) {
+    if (len < 10) {
+      return RET_ERROR;
+    }
+    command->param_mask = 0;
+    int i;
+    for (i = 7; i >= 0; i--) {
+      command->param_mask = (command->param_mask << 8) | payload[2 + i];
+    }
+  }
+
+  if (command->id == SET_PARAM) {
+    if (len < 7) {
+      return RET_ERROR;
+    }
+    // Both int and float values are sent as 4 raw bytes, little endian.
+    uint32_t raw = payload[3] | (payload[4] << 8) | (payload[5] << 16) | (payload[6] << 24);
+    memcpy(&command->value, &raw, sizeof(raw));
+  }
+  return RET_OK;
+}
+
+uint8_t link_encode_param(uint8_t id, tele_command_type_t type, const tele_value_t *value, uint8_t *out) {
+  uint32_t raw;
+  memcpy(&raw, value, sizeof(raw));
+  out[0] = id;
+  out[1] = type;
+  out[2] = raw & 0xFF;
+  out[3] = (raw >> 8) & 0xFF;
+  out[4] = (raw >> 16) & 0xFF;
+  out[5] = (raw >> 24) & 0xFF;
+  return LINK_PARAM_SIZE;
+}
+
+uint8_t link_encode_response(const command_t *command, int err, uint8_t *payload) {
+  payload[0] = command->seq;
+  payload[1] = err;
+
+  if (err != RET_OK) {
+    return 2;
+  }
+
+  if (command->id == GET_PARAM) {
+    return 2 + link_encode_param(command->tele_param->id, command->tele_param->type, &command->value, &payload[2]);
+  }
+
+  if (command->id == CONFIG && command->config_op == CONFIG_OP_GET) {
+    return 2 + link_encode_param(command->setting->id, command->setting->type, &command->value, &payload[2]);
+  }
+  return 2;
+}
+
+void link_send_response(RawSerial *serial, const command_t *command, int err, thread_args_t *targs) {
+  uint8_t payload[LINK_MAX_PAYLOAD];
+  uint8_t len = link_encode_response(command, err, payload);
+
+  if (err != RET_OK || command->id != GET_PARAMS) {
+    link_send_frame(serial, payload, len);
+    return;
+  }
+
+  unsigned i;
+  tele_value_t value;
+  for (i = 0; i < NUM_TELE_COMMANDS; i++) {
+    if (!(command->param_mask & TELE_PARAM_MASK(i))) {
+      continue;
+    }
+    if (len + LINK_PARAM_SIZE > LINK_MAX_PAYLOAD) {
+      link_send_frame(serial, payload, len);
+      len = 2;
+    }
+    targs->mutex.telemetry->lock();
+    value = tele_commands[i].param;
+    targs->mutex.telemetry->unlock();
+    len += link_encode_param(tele_commands[i].id, tele_commands[i].type, &value, &payload[len]);
+  }
+  link_send_frame(serial, payload, len);
+}
+
+#if defined(DEVICE_ESP8266) && defined(TASK_PROCESS_COMMANDS)
+
+static thread_args_t *esp_targs;
+static link_parser_t esp_parser;
+static link_stats_t esp_stats;
+
+/**
+* @brief Drain the ESP8266 UART, queueing a command for each complete frame.
+* @note Runs in interrupt context, so only ISR safe calls may be made.
+*/
+static void link_esp8266_rx_isr(void) {
+  while (esp_targs->esp_serial->readable()) {
+    uint8_t byte = esp_targs->esp_serial->getc();
+    bool was_waiting_crc = (esp_parser.state == LINK_WAIT_CRC);
+
+    if (!link_parser_feed(&esp_parser, byte)) {
+      if (was_waiting_crc) {
+        esp_stats.crc_errors++;
+      }
+      continue;
+    }
+    esp_stats.frames++;
+
+    command_t command;
+    memset(&command, 0x00, sizeof(command_t));
+    if (link_decode_command(esp_parser.payload, esp_parser.len, &command) != RET_OK) {
+      esp_stats.dropped++;
+      continue;
+    }
+    command.link = LINK_ESP8266;
+
+    // command_submit() never waits for space in the queue
+    if (command_submit(esp_targs, &command) != RET_OK) {
+      esp_stats.dropped++;
+    }
+  }
+}
+
+void link_esp8266_init(thread_args_t *targs) {
+  esp_targs = targs;
+  link_parser_reset(&esp_parser);
+  targs->esp_serial->attach(&link_esp8266_rx_isr, RawSerial::RxIrq);
+}
+
+const link_stats_t * link_esp8266_stats(void) {
+  return &esp_stats;
+}
+
+#endif
+
+#ifdef TASK_PROCESS_COMMANDS
+
+static thread_args_t *usb_targs;
+static link_parser_t usb_parser;
+static link_stats_t usb_stats;
+
+void link_usb_init(thread_args_t *targs) {
+  usb_targs = targs;
+  link_parser_reset(&usb_parser);
+}
+
+bool link_usb_feed(uint8_t byte) {
+  if (usb_targs == NULL || (usb_parser.state == LINK_WAIT_SYNC && byte != LINK_SYNC)) {
+    return false;
+  }
+
+  bool was_waiting_crc = (usb_parser.state == LINK_WAIT_CRC);
+  if (!link_parser_feed(&usb_parser, byte)) {
+    if (was_waiting_crc) {
+      usb_stats.crc_errors++;
+    }
+    return true;
+  }
+  usb_stats.frames++;
+
+  command_t command;
+  memset(&command, 0x00, sizeof(command_t));
+  if (link_decode_command(usb_parser.payload, usb_parser.len, &command) != RET_OK) {
+    usb_stats.dropped++;
+    return true;
+  }
+  command.link = LINK_USB_BINARY;
+
+  // Requests may be pipelined, the seq in each response pairs it up
+  if (command_submit(usb_targs, &command) != RET_OK) {
+    usb_stats.dropped++;
+  }
+  return true;
+}
+
+const link_stats_t * link_usb_stats(void) {
+  return &usb_stats;
+}
+
+#endif
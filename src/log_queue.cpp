@@ -0,0 +1,388 @@
+/* Copyright (c) 2018 Cameron A. Craig, MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ * BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * @file log_queue.cpp
+ * @author Cameron A. Craig
+ * @date 19 Mar 2018
+ * @copyright 2018 Cameron A. Craig
+ * @brief Defers formatting and output of log messages to a low priority thread,
+ *        which writes them out one whole message at a time, most urgent first.
+ */
+
+#include "mbed.h"
+#include "rtos.h"
+#include "log_queue.h"
+#include "return_codes.h"
+
+/**
+ * A queued message: the format and its raw arguments.
+ */
+typedef struct {
+  /*! Set to the message's queue position + 1 once it is complete. */
+  volatile uint32_t sequence;
+  const char *format;
+  uint32_t words;
+  bool truncated;
+  uint32_t args[LOG_QUEUE_MAX_ARG_WORDS];
+} log_entry_t;
+
+/**
+ * The messages of one channel, written out in the order they were queued.
+ */
+typedef struct {
+  log_entry_t *entries;
+  uint32_t len;
+  /*! Next position to reserve, advanced by any producer. */
+  volatile uint32_t head;
+  /*! Next position to write out, only advanced by the writer. */
+  volatile uint32_t tail;
+  volatile uint32_t dropped;
+} log_channel_queue_t;
+
+static log_entry_t log_alert_entries[LOG_ALERT_QUEUE_LEN];
+static log_entry_t log_console_entries[LOG_CONSOLE_QUEUE_LEN];
+static log_entry_t log_debug_entries[LOG_DEBUG_QUEUE_LEN];
+
+/* Indexed by log_channel_t, so the most urgent channel comes first */
+static log_channel_queue_t log_channels[NUM_LOG_CHANNELS] = {
+  {log_alert_entries,   LOG_ALERT_QUEUE_LEN,   0, 0, 0},
+  {log_console_entries, LOG_CONSOLE_QUEUE_LEN, 0, 0, 0},
+  {log_debug_entries,   LOG_DEBUG_QUEUE_LEN,   0, 0, 0},
+};
+
+static Thread *log_writer = NULL;
+static volatile bool log_writer_waiting = false;
+
+static volatile uint32_t log_written = 0;
+static volatile uint32_t log_truncated = 0;
+
+void log_queue_init(Thread *writer) {
+  log_writer = writer;
+}
+
+/**
+* @brief Is c part of a conversion's flags, width, precision or length?
+*/
+static bool log_is_modifier(char c) {
+  return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == ' ' || c == '#' ||
+    c == '.' || c == '*' || c == 'h' || c == 'l' || c == 'L' || c == 'z' || c == 'j' || c == 't';
+}
+
+/**
+* @brief Is c a conversion that takes a double?
+*/
+static bool log_is_double(char c) {
+  return c == 'f' || c == 'F' || c == 'e' || c == 'E' || c == 'g' || c == 'G' || c == 'a' || c == 'A';
+}
+
+/**
+* @brief Take the next position in a channel's queue.
+* @return Entry to fill in, or NULL if the queue is full.
+*/
+static log_entry_t *log_queue_reserve(log_channel_queue_t *queue) {
+  uint32_t head;
+  do {
+    head = __LDREXW(&queue->head);
+    if (head - queue->tail >= queue->len) {
+      __CLREX();
+      return NULL;
+    }
+  } while (__STREXW(head + 1, &queue->head) != 0);
+
+  log_entry_t *entry = &queue->entries[head % queue->len];
+  // Not complete until the sequence matches
+  entry->sequence = head;
+  return entry;
+}
+
+/**
+* @brief Store the arguments of a message, taking each one with the type
+*        its conversion says it was passed as, then hand it to the writer.
+*/
+static void log_queue_commit(log_entry_t *entry, const char *format, va_list ap) {
+  const char *p = format;
+  uint32_t n = 0;
+
+  entry->format = format;
+  entry->truncated = false;
+
+  while (*p != '\0') {
+    if (*p++ != '%') {
+      continue;
+    }
+    if (*p == '%') {
+      p++;
+      continue;
+    }
+
+    bool long_long = false;
+    for (; log_is_modifier(*p); p++) {
+      if (*p == '*') {
+        // Width or precision given as an argument
+        if (n >= LOG_QUEUE_MAX_ARG_WORDS) {
+          entry->truncated = true;
+          break;
+        }
+        entry->args[n++] = (uint32_t) va_arg(ap, int);
+      } else if (p[0] == 'l' && p[1] == 'l') {
+        long_long = true;
+      }
+    }
+    if (*p == '\0' || entry->truncated) {
+      break;
+    }
+
+    uint32_t words = (log_is_double(*p) || long_long) ? 2 : 1;
+    if (n + words > LOG_QUEUE_MAX_ARG_WORDS) {
+      entry->truncated = true;
+      break;
+    }
+    if (log_is_double(*p)) {
+      double d = va_arg(ap, double);
+      memcpy(&entry->args[n], &d, sizeof(d));
+    } else if (long_long) {
+      long long ll = va_arg(ap, long long);
+      memcpy(&entry->args[n], &ll, sizeof(ll));
+    } else if (*p == 's' || *p == 'p') {
+      entry->args[n] = (uint32_t) (uintptr_t) va_arg(ap, void*);
+    } else {
+      entry->args[n] = va_arg(ap, unsigned);
+    }
+    n += words;
+    p++;
+  }
+  entry->words = n;
+
+  // The entry must be complete before the writer can see it
+  __DMB();
+  entry->sequence++;
+
+  if (log_writer_waiting && log_writer != NULL) {
+    log_writer_waiting = false;
+    log_writer->signal_set(LOG_QUEUE_SIGNAL);
+  }
+}
+
+int log_queue_write(log_channel_t channel, const char *format, ...) {
+  log_channel_queue_t *queue = &log_channels[channel];
+  log_entry_t *entry = log_queue_reserve(queue);
+  if (entry == NULL) {
+    core_util_atomic_incr_u32(&queue->dropped, 1);
+    return RET_ERROR;
+  }
+
+  va_list ap;
+  va_start(ap, format);
+  log_queue_commit(entry, format, ap);
+  va_end(ap);
+  return RET_OK;
+}
+
+void log_queue_print(const char *format, ...) {
+  log_channel_queue_t *queue = &log_channels[LOG_CHANNEL_CONSOLE];
+  log_entry_t *entry;
+  while ((entry = log_queue_reserve(queue)) == NULL) {
+    if (core_util_is_isr_active()) {
+      core_util_atomic_incr_u32(&queue->dropped, 1);
+      return;
+    }
+    // Let the writer make room
+    Thread::wait(1);
+  }
+
+  va_list ap;
+  va_start(ap, format);
+  log_queue_commit(entry, format, ap);
+  va_end(ap);
+}
+
+/**
+* @brief Format one conversion, spec being e.g. "%-8.2f".
+* @return As snprintf().
+*/
+static int log_format_arg(char *out, size_t size, const char *spec, char conversion,
+    bool long_long, const uint32_t *args) {
+  if (log_is_double(conversion)) {
+    double d;
+    memcpy(&d, args, sizeof(d));
+    return snprintf(out, size, spec, d);
+  }
+  if (long_long) {
+    long long ll;
+    memcpy(&ll, args, sizeof(ll));
+    return snprintf(out, size, spec, ll);
+  }
+  if (conversion == 's') {
+    const char *s = (const char *) (uintptr_t) args[0];
+    return snprintf(out, size, spec, s != NULL ? s : "(null)");
+  }
+  if (conversion == 'p') {
+    return snprintf(out, size, spec, (void *) (uintptr_t) args[0]);
+  }
+  return snprintf(out, size, spec, args[0]);
+}
+
+/**
+* @brief Format a queued message into a line.
+* @return false if it did not fit.
+*/
+static bool log_format(char *line, size_t size, const log_entry_t *entry) {
+  const char *p = entry->format;
+  size_t len = 0;
+  uint32_t n = 0;
+  char spec[24];
+
+  while (*p != '\0') {
+    if (len + 1 >= size) {
+      line[len] = '\0';
+      return false;
+    }
+    if (*p != '%') {
+      line[len++] = *p++;
+      continue;
+    }
+    if (p[1] == '%') {
+      line[len++] = '%';
+      p += 2;
+      continue;
+    }
+
+    // Copy the conversion, writing any '*' out as the number it stands for
+    size_t spec_len = 0;
+    bool long_long = false;
+    spec[spec_len++] = *p++;
+    for (; log_is_modifier(*p) && spec_len < sizeof(spec) - 12; p++) {
+      if (*p == '*') {
+        if (n >= entry->words) {
+          break;
+        }
+        spec_len += snprintf(&spec[spec_len], sizeof(spec) - spec_len, "%d", (int) entry->args[n++]);
+      } else {
+        if (p[0] == 'l' && p[1] == 'l') {
+          long_long = true;
+        }
+        spec[spec_len++] = *p;
+      }
+    }
+    if (*p == '\0') {
+      break;
+    }
+    char conversion = *p++;
+    spec[spec_len++] = conversion;
+    spec[spec_len] = '\0';
+
+    uint32_t words = (log_is_double(conversion) || long_long) ? 2 : 1;
+    if (n + words > entry->words) {
+      // Arguments that did not fit in the queue
+      line[len] = '\0';
+      return false;
+    }
+    int written = log_format_arg(&line[len], size - len, spec, conversion, long_long, &entry->args[n]);
+    n += words;
+    if (written < 0) {
+      continue;
+    }
+    if ((size_t) written >= size - len) {
+      len = size - 1;
+      line[len] = '\0';
+      return false;
+    }
+    len += written;
+  }
+  line[len] = '\0';
+  return !entry->truncated;
+}
+
+/**
+* @brief Oldest complete message of a channel.
+* @return The message, or NULL if there are none (or the oldest is still
+*         being written).
+*/
+static log_entry_t *log_queue_next(log_channel_queue_t *queue) {
+  log_entry_t *entry = &queue->entries[queue->tail % queue->len];
+  if (entry->sequence != queue->tail + 1) {
+    return NULL;
+  }
+  __DMB();
+  return entry;
+}
+
+/**
+* @brief Oldest complete message of the most urgent channel that has one.
+* @param [out] queue Channel the message is from.
+*/
+static log_entry_t *log_queue_next_any(log_channel_queue_t **queue) {
+  unsigned c;
+  for (c = 0; c < NUM_LOG_CHANNELS; c++) {
+    log_entry_t *entry = log_queue_next(&log_channels[c]);
+    if (entry != NULL) {
+      *queue = &log_channels[c];
+      return entry;
+    }
+  }
+  return NULL;
+}
+
+void log_queue_flush(RawSerial *serial) {
+  char line[LOG_QUEUE_LINE_LENGTH];
+  log_channel_queue_t *queue;
+  log_entry_t *entry;
+
+  // Channels are checked again after every message, so an alert is never
+  // stuck behind the rest of a long listing
+  while ((entry = log_queue_next_any(&queue)) != NULL) {
+    if (!log_format(line, sizeof(line), entry)) {
+      log_truncated++;
+    }
+    // One write per message, so it is never split by another writer
+    serial->puts(line);
+    log_written++;
+
+    // Hand the entry back to the producers
+    __DMB();
+    queue->tail++;
+  }
+}
+
+void log_queue_wait(uint32_t timeout_ms) {
+  log_channel_queue_t *queue;
+  log_writer_waiting = true;
+  // A message may have been queued before the flag was set
+  if (log_queue_next_any(&queue) != NULL) {
+    log_writer_waiting = false;
+    return;
+  }
+  Thread::signal_wait(LOG_QUEUE_SIGNAL, timeout_ms);
+  log_writer_waiting = false;
+}
+
+void log_queue_wake(void) {
+  // Unlike a message, not seen by log_queue_wait()'s check, so always
+  // signal rather than only when the writer is already waiting
+  if (log_writer != NULL) {
+    log_writer->signal_set(LOG_QUEUE_SIGNAL);
+  }
+}
+
+void log_queue_get_stats(log_queue_stats_t *stats) {
+  unsigned c;
+  stats->written = log_written;
+  for (c = 0; c < NUM_LOG_CHANNELS; c++) {
+    stats->dropped[c] = log_channels[c].dropped;
+  }
+  stats->truncated = log_truncated;
+}
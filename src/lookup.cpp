@@ -0,0 +1,100 @@
+/* Copyright (c) 2018 Cameron A. Craig, MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ * BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * @file lookup.cpp
+ * @author Cameron A. Craig
+ * @date 3 Mar 2018
+ * @copyright 2018 Cameron A. Craig
+ * @brief Perfect hash tables for O(1) exact name lookups.
+ */
+
+#include <string.h>
+#include "lookup.h"
+
+/**
+* @brief Seeded FNV-1a hash of len bytes of key.
+*/
+static uint32_t lookup_hash(uint32_t seed, const char *key, size_t len) {
+  uint32_t hash = 2166136261U ^ seed;
+  size_t i;
+  for (i = 0; i < len; i++) {
+    hash ^= (uint8_t) key[i];
+    hash *= 16777619U;
+  }
+  return hash;
+}
+
+bool lookup_build(lookup_table_t *table, const char * (*name)(unsigned index), unsigned count) {
+  unsigned i;
+  uint32_t seed;
+
+  table->name = name;
+  table->count = count;
+  table->perfect = false;
+
+  // Aim for a sparse table, collision free seeds are found much quicker
+  table->size = 1;
+  while (table->size < count * 4 && table->size < LOOKUP_MAX_SLOTS) {
+    table->size <<= 1;
+  }
+
+  if (count >= LOOKUP_MAX_SLOTS) {
+    return false;
+  }
+
+  for (seed = 0; seed < LOOKUP_MAX_SEEDS; seed++) {
+    memset(table->slots, 0x00, sizeof(table->slots));
+
+    for (i = 0; i < count; i++) {
+      const char *n = name(i);
+      uint32_t slot = lookup_hash(seed, n, strlen(n)) & (table->size - 1);
+      if (table->slots[slot] != 0) {
+        break;
+      }
+      table->slots[slot] = i + 1;
+    }
+
+    if (i == count) {
+      table->seed = seed;
+      table->perfect = true;
+      return true;
+    }
+  }
+  return false;
+}
+
+int lookup_find(const lookup_table_t *table, const char *key, size_t len) {
+  unsigned i;
+
+  if (table->perfect) {
+    uint32_t slot = lookup_hash(table->seed, key, len) & (table->size - 1);
+    if (table->slots[slot] == 0) {
+      return -1;
+    }
+    i = table->slots[slot] - 1;
+    const char *n = table->name(i);
+    return (strlen(n) == len && memcmp(n, key, len) == 0) ? (int) i : -1;
+  }
+
+  for (i = 0; i < table->count; i++) {
+    const char *n = table->name(i);
+    if (strlen(n) == len && memcmp(n, key, len) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
@@ -40,6 +40,7 @@
 #include "esc.h"
 #include "PwmIn.h"
 #include "assert.h"
+#include <new>
 
 #include "bno055.h"
 #include "tmath.h"
@@ -53,17 +54,27 @@
 #include "drive_modes.h"
 #include "comms_pwm.h"
 #include "comms_vesc_can.h"
+#include "link.h"
+#include "cli.h"
+#include "commands.h"
+#include "tele_params.h"
+#include "task_control.h"
+#include "settings.h"
+#include "mem_stats.h"
+#include "warm_start.h"
+#include "task_utils.h"
+#include "boot_trace.h"
+#include "state_outputs.h"
+#include "esc_cutoff.h"
+#include "weapon_rpm.h"
 
 /* Make available the ESC comms implementations */
 extern comms_impl_t comms_impl_pwm;
 extern comms_impl_t comms_impl_vesc_can;
 
-// For memory debugging
-// #include "mbed_memory_status.h"
-
 /* Set up logging */
 LocalFileSystem local("local");
-Serial *serial_ptr;
+RawSerial *serial_ptr;
 
 int esp8266_wait_until_ready(thread_args_t *args) {
   unsigned esp8266_init_attempts = 0;
@@ -73,7 +84,8 @@ int esp8266_wait_until_ready(thread_args_t *args) {
     if(esp8266_init_attempts > 5) {
       // Disable tasks that require the BNO055
 #if defined(TASK_STREAM_TELEMETRY) && defined(DEVICE_ESP8266)
-      args->tasks[TASK_STREAM_TELEMETRY_ID].active = false;
+      // Threads aren't running yet, they start parked
+      tasks[TASK_STREAM_TELEMETRY_ID].active = false;
 #endif
       return RET_ERROR;
     }
@@ -88,7 +100,10 @@ int bno055_wait_until_ready(thread_args_t *args) {
     if(bno055_init_attempts > 5) {
       // Disable tasks that require the BNO055
 #ifdef TASK_COLLECT_TELEMETRY
-      args->tasks[TASK_COLLECT_TELEMETRY_ID].active = false;
+      // Threads aren't running yet, they start parked
+      tasks[TASK_COLLECT_TELEMETRY_ID].active = false;
+#elif defined(TASK_EXECUTIVE)
+      task_executive_disable(task_collect_telemetry_step);
 #endif
       return RET_ERROR;
     }
@@ -101,9 +116,15 @@ int bno055_wait_until_ready(thread_args_t *args) {
  * Main Loop
  */
 int main() {
-  // Configure serial connection to a PC (for debug)
-  Serial *serial = new Serial(USBTX, USBRX);
-  serial->baud(115200);
+  // Before anything else runs on the ISR stack, so its peak is measured
+  mem_stats_init();
+
+  boot_trace("USB serial");
+  // Configure serial connection to a PC (for debug). Every write to the port
+  // holds this mutex, so whole messages from different threads never mix.
+  Mutex *pc_serial_mutex = new Mutex();
+  LockedSerial *serial = new LockedSerial(USBTX, USBRX, pc_serial_mutex);
+  serial->baud(USB_SERIAL_BAUD);
 
   // Initialise thread arguments structure
   thread_args_t *targs;
@@ -114,22 +135,30 @@ int main() {
   // Create watchdog timer
   targs->wdt = new Watchdog();
 
-  /* TODO: If recovering from a hang, we will want to restore arming state.
-     This means that if we hang during a fight, there should be minimal
-     interruption to control.
-
-    Currently we arm using a switch on each controller so this isn't strictly
-	necessary, but if we ever change arming mechanism to stick positions, then
-	we'll need to be clever here and store arming state somewhere non-volatile.
+  /* If recovering from a hang, restore the arming state, settings and
+     outputs saved in no-init RAM, so that a hang during a fight causes
+     minimal interruption to control. A warm restart skips the slow device
+     set up and chatter, aiming for live outputs within
+     WARM_START_TARGET_MS of the start of main(). Time from the reset to
+     main() is not measured, as the us ticker only starts on first use.
   */
+  bool warm_restart = targs->wdt->is_wdt_reset() && warm_start_available();
+
+  // Always taken, so a reason left by an earlier reset is never reported
+  char reset_reason[WATCHDOG_REASON_LEN + 1];
+  bool has_reset_reason = targs->wdt->take_reset_reason(reset_reason);
   if(targs->wdt->is_wdt_reset()) {
     serial->puts("System recovering from watchdog reset.\r\n");
+    if (has_reset_reason) {
+      serial->printf("Missed heartbeat: %s\r\n", reset_reason);
+    }
   } else {
     serial->puts("System booting normally.\r\n");
   }
 
+  boot_trace("ESP8266 serial");
   // Configure serial connection to ESP8266
-  targs->esp_serial = new Serial(ESP_TX, ESP_RX);
+  targs->esp_serial = new RawSerial(ESP_TX, ESP_RX);
   targs->esp_serial->baud(115200);
 
   // Set up ready line, so the ESP8266 can tell when it's ready.
@@ -140,29 +169,34 @@ int main() {
   targs->serial = serial;
   serial_ptr = serial;
 
-  //For memory debugging
-  // print_all_thread_info();
-  // print_heap_and_isr_stack_info();
-
+  boot_trace("Banner");
   // Print initial messsage inidicating start of new process
   targs->serial->puts("Triforce Control System v");
   targs->serial->puts(VERSION);
   targs->serial->puts("\r\n");
 
+  // The BNO055 and ESP8266 were not reset, and keep their configuration
 #ifdef DEVICE_BNO055
-  targs->serial->printf("init(): BNO055\r\n");
-  if (!bno055_wait_until_ready(targs)){
-    targs->serial->printf("\tBNO055 not in use.\r\n");
-  };
+  if (!warm_restart) {
+    boot_trace("BNO055");
+    targs->serial->printf("init(): BNO055\r\n");
+    if (!bno055_wait_until_ready(targs)){
+      targs->serial->printf("\tBNO055 not in use.\r\n");
+    };
+  }
 #endif
 
 #ifdef DEVICE_ESP8266
-  targs->serial->printf("init(): ESP8266\r\n");
-  if (!esp8266_wait_until_ready(targs)) {
-    targs->serial->printf("\tESP8266 not in use.\r\n");
+  if (!warm_restart) {
+    boot_trace("ESP8266");
+    targs->serial->printf("init(): ESP8266\r\n");
+    if (!esp8266_wait_until_ready(targs)) {
+      targs->serial->printf("\tESP8266 not in use.\r\n");
+    }
   }
 #endif
 
+  boot_trace("PWM inputs");
   targs->serial->puts("init(): PWM inputs\r\n");
 
   /* RC inputs from two reveiver units */
@@ -184,49 +218,21 @@ int main() {
     RECV_W_CHAN_6_PIN
   };
 
-  /* Set and print channel limits, these can be modified at runtime using the
-  calibrate command. */
-
-  targs->channel_limits[0][0].min = RC_0_CHAN_1_MIN;
-  targs->channel_limits[0][0].max = RC_0_CHAN_1_MAX;
-
-  targs->channel_limits[0][1].min = RC_0_CHAN_2_MIN;
-  targs->channel_limits[0][1].max = RC_0_CHAN_2_MAX;
-
-  targs->channel_limits[0][2].min = RC_0_CHAN_3_MIN;
-  targs->channel_limits[0][2].max = RC_0_CHAN_3_MAX;
-
-  targs->channel_limits[0][3].min = RC_0_CHAN_4_MIN;
-  targs->channel_limits[0][3].max = RC_0_CHAN_4_MAX;
-
-  targs->channel_limits[0][4].min = RC_0_CHAN_5_MIN;
-  targs->channel_limits[0][4].max = RC_0_CHAN_5_MAX;
-
-  targs->channel_limits[0][5].min = RC_0_CHAN_6_MIN;
-  targs->channel_limits[0][5].max = RC_0_CHAN_6_MAX;
-
-  targs->channel_limits[1][0].min = RC_1_CHAN_1_MIN;
-  targs->channel_limits[1][0].max = RC_1_CHAN_1_MAX;
-
-  targs->channel_limits[1][1].min = RC_1_CHAN_2_MIN;
-  targs->channel_limits[1][1].max = RC_1_CHAN_2_MAX;
-
-  targs->channel_limits[1][2].min = RC_1_CHAN_3_MIN;
-  targs->channel_limits[1][2].max = RC_1_CHAN_3_MAX;
-
-  targs->channel_limits[1][3].min = RC_1_CHAN_4_MIN;
-  targs->channel_limits[1][3].max = RC_1_CHAN_4_MAX;
-
-  targs->channel_limits[1][4].min = RC_1_CHAN_5_MIN;
-  targs->channel_limits[1][4].max = RC_1_CHAN_5_MAX;
-
-  targs->channel_limits[1][5].min = RC_1_CHAN_6_MIN;
-  targs->channel_limits[1][5].max = RC_1_CHAN_6_MAX;
+  boot_trace("Settings");
+  /* Load default settings, including the channel limits. These can be
+  modified at runtime using the calibrate and cfg commands. */
+  if (!settings_init()) {
+    targs->serial->puts("init(): No perfect hash for settings, using linear lookup\r\n");
+  }
 
+  boot_trace("Receiver test reads");
   uint32_t chan;
   for (chan= 0; chan < RC_NUMBER_CHANNELS; chan++) {
     targs->receiver[0].channel[chan] = &rx_weapon[chan];
     targs->receiver[1].channel[chan] = &rx_drive[chan];
+    if (warm_restart) {
+      continue;
+    }
     // A test read ensures PwmIn is configured correctly
     targs->serial->printf("\tinit(): RX %d channel %d: %d\r\n",
       0, chan,
@@ -238,6 +244,7 @@ int main() {
         targs->receiver[1].channel[chan]->pulsewidth()));
   }
 
+  boot_trace("LEDs");
   targs->serial->puts("init(): onboard LEDS\r\n");
 
   /* LEDs */
@@ -253,11 +260,28 @@ int main() {
     targs->leds[l] = &led[l];
   }
 
-  //Set drive mode
-  //TODO(camieac): Make drive & weapon mode configurable
-  targs->drive_mode = (drive_mode_t*) &drive_modes[DM_2_WHEEL_DIFFERENTIAL];
-  targs->weapon_mode = (weapon_mode_t*) &weapon_modes[WM_MANUAL_THROTTLE];
+  boot_trace("Restore state");
+  if (warm_restart) {
+    warm_start_restore(targs);
+  } else {
+    warm_start_reset();
+  }
+
+  //Set drive mode, the motor drive task follows any change to the settings
+  settings_t settings;
+  settings_read(&settings);
+  targs->drive_mode = (drive_mode_t*) &drive_modes[settings.drive_mode];
+  targs->weapon_mode = (weapon_mode_t*) &weapon_modes[settings.weapon_mode];
+
+  boot_trace("Mutexes");
+  targs->serial->puts("init(): Mutexes\r\n");
+  targs->mutex.pc_serial = pc_serial_mutex;
+  targs->mutex.esp_serial = new Mutex();
+  targs->mutex.controls = new Mutex();
+  targs->mutex.outputs = new Mutex();
+  targs->mutex.telemetry = new Mutex();
 
+  boot_trace("PWM outputs");
   targs->serial->puts("init(): PWM Outputs\r\n");
 
   //Set ESC comms implementation
@@ -274,98 +298,152 @@ int main() {
   targs->comms_impl->init_esc(&targs->escs.weapon[1], COMMS_OUTPUT_WEAPON_2);
   targs->comms_impl->init_esc(&targs->escs.weapon[2], COMMS_OUTPUT_WEAPON_1);
 
+  // ESC gate, LEDs, telemetry and flight log follow the state from here on
+  state_outputs_init(targs);
+
+  // Stalled receivers now stop their ESCs without waiting for a task
+  esc_cutoff_init(targs);
+
+  // Weapon speed, for telemetry and RPM hold mode
+  weapon_rpm_init();
+
+  if (warm_restart) {
+    // Hold the last frame until the control loop takes over
+    set_output_escs(targs);
+    targs->serial->printf("init(): Warm restart, %s, outputs live %lu ms after main() started (target %d ms)\r\n",
+      state_to_str(targs->state), (unsigned long) (us_ticker_read() / 1000), WARM_START_TARGET_MS);
+  }
+
+  boot_trace("Command queue");
   targs->serial->puts("init(): Command Queue\r\n");
 
   Mail<command_t, COMMAND_QUEUE_LEN> *command_queue = new Mail<command_t, COMMAND_QUEUE_LEN>();
   targs->command_queue = command_queue;
 
-  targs->serial->puts("init(): Mutexes\r\n");
-  targs->mutex.pc_serial = new Mutex();
-  targs->mutex.controls = new Mutex();
-  targs->mutex.outputs = new Mutex();
-  targs->mutex.telemetry = new Mutex();
+  Mail<command_t, SAFETY_COMMAND_QUEUE_LEN> *safety_command_queue = new Mail<command_t, SAFETY_COMMAND_QUEUE_LEN>();
+  targs->safety_command_queue = safety_command_queue;
 
+  // Command and parameter names are hashed once here, lookups are then O(1)
+  bool commands_hashed = command_init();
+  bool params_hashed = tele_params_init();
+  if (!commands_hashed || !params_hashed) {
+    targs->serial->puts("init(): No perfect hash, using linear lookup\r\n");
+  }
+
+#if defined(DEVICE_ESP8266) && defined(TASK_PROCESS_COMMANDS)
+  // Accept commands from the telemetry client
+  boot_trace("ESP8266 command link");
+  targs->serial->puts("init(): ESP8266 Command Link\r\n");
+  link_esp8266_init(targs);
+#endif
+
+#ifdef TASK_PROCESS_COMMANDS
+  // Accept framed binary requests alongside the command line on USB
+  boot_trace("USB binary link");
+  targs->serial->puts("init(): USB Binary Link\r\n");
+  link_usb_init(targs);
+#endif
+
+  boot_trace("Flight log");
+  targs->serial->puts("init(): Flight Log\r\n");
+  flight_log_t *flight_log = (flight_log_t*) malloc(sizeof(flight_log_t));
+  flight_log_init(flight_log);
+  // Held if a warm restart came back armed, the state outputs keep it up to date
+  core_util_critical_section_enter();
+  flight_log_hold(flight_log, targs->state != STATE_DISARMED);
+  targs->flight_log = flight_log;
+  core_util_critical_section_exit();
+
+  boot_trace("Create threads");
   targs->serial->printf("init(): Starting %d Tasks\r\n", NUM_TASKS);
 
   // Allow access to tasks from threads
   targs->tasks = (task_t *) &tasks;
 
-  Thread threads[NUM_TASKS] = {
-#ifdef TASK_READ_SERIAL
-    {tasks[TASK_READ_SERIAL_ID].priority, tasks[TASK_READ_SERIAL_ID].stack_size},
-#endif
-#ifdef TASK_PROCESS_COMMANDS
-    {tasks[TASK_PROCESS_COMMANDS_ID].priority, tasks[TASK_PROCESS_COMMANDS_ID].stack_size},
-#endif
-#ifdef TASK_LED_STATE
-    {tasks[TASK_LED_STATE_ID].priority, tasks[TASK_LED_STATE_ID].stack_size},
-#endif
-#ifdef TASK_MOTOR_DRIVE
-    {tasks[TASK_MOTOR_DRIVE_ID].priority, tasks[TASK_MOTOR_DRIVE_ID].stack_size},
-#endif
-#ifdef TASK_ARMING
-    {tasks[TASK_ARMING_ID].priority, tasks[TASK_ARMING_ID].stack_size},
-#endif
-#ifdef TASK_FAILSAFE
-    {tasks[TASK_FAILSAFE_ID].priority, tasks[TASK_FAILSAFE_ID].stack_size},
-#endif
-#if defined(TASK_CALC_ORIENTATION) && defined(DEVICE_BNO055)
-    {tasks[TASK_CALC_ORIENTATION_ID].priority, tasks[TASK_CALC_ORIENTATION_ID].stack_size},
-#endif
-#ifdef TASK_COLLECT_TELEMETRY
-    {tasks[TASK_COLLECT_TELEMETRY_ID].priority, tasks[TASK_COLLECT_TELEMETRY_ID].stack_size},
-#endif
-#if defined(TASK_STREAM_TELEMETRY) && defined(DEVICE_ESP8266)
-    {tasks[TASK_STREAM_TELEMETRY_ID].priority, tasks[TASK_STREAM_TELEMETRY_ID].stack_size},
-#endif
-#ifdef TASK_CALIBRATE_CHANNELS
-    {tasks[TASK_CALIBRATE_CHANNELS_ID].priority, tasks[TASK_CALIBRATE_CHANNELS_ID].stack_size}
-#endif
-  };
+  // Periodic tasks are ranked by deadline before their threads are created
+  task_assign_priorities(targs->tasks, NUM_TASKS);
+
+  // A task's ID is its index in tasks[] and threads[]. Its thread is built
+  // from its own entry below, so check the table before trusting that.
+  uint32_t t;
+  unsigned periodic = 0;
+  for (t = 0; t < NUM_TASKS; t++) {
+    if (tasks[t].id != t) {
+      error("init(): tasks[%d] is %s (ID %d), reorder tasks[] to match tasks.h\r\n",
+        t, tasks[t].name, tasks[t].id);
+    }
+    if (tasks[t].period_ms != 0 && tasks[t].priority >= osPriorityNormal) {
+      periodic++;
+    }
+  }
+  // The priority levels are sized for NUM_PERIODIC_TASKS, see task_control.h
+  if (periodic > NUM_PERIODIC_TASKS) {
+    error("init(): %d periodic tasks, update NUM_PERIODIC_TASKS in tasks.h\r\n", periodic);
+  }
+
+  // Static, so the Thread objects do not take up the main stack. Each is
+  // constructed in place from its own task entry.
+  static uint64_t thread_mem[NUM_TASKS][(sizeof(Thread) + sizeof(uint64_t) - 1) / sizeof(uint64_t)];
+  Thread *threads = (Thread*) thread_mem;
+  for (t = 0; t < NUM_TASKS; t++) {
+    new (&threads[t]) Thread(tasks[t].priority, tasks[t].stack_size, tasks[t].stack_mem);
+  }
   // Allow access to Thread objects thread thread_args
-  targs->threads = (Thread*) &threads;
+  targs->threads = threads;
 
   // Print all tasks and their properties
-  uint32_t t;
   for (t = 0; t < NUM_TASKS; t++) {
     targs->serial->printf("\rinit(): Task %d (%s) active: %s, stack: %d\r\n", tasks[t].id, tasks[t].name, tasks[t].active ? "Yes" : "No", tasks[t].stack_size);
   }
 
+  // Time each task iteration with the CPU cycle counter
+  task_control_init();
+
   //Start watchdog timer before we start the tasks
   targs->wdt->kick(WATCHDOG_TIME_SECONDS);
 
   // Start all tasks
+  boot_trace("Start threads");
   for (t = 0; t < NUM_TASKS; t++) {
     // Print amount of heap used
     // print_heap_and_isr_stack_info();
 
     targs->serial->printf("\rinit(): Starting %s (%d) active?: %s\r\n", tasks[t].name, tasks[t].id, tasks[t].active ? "Yes" : "No");
     tasks[t].args = targs;
-    // threads[t].set_priority(tasks[t].priority);
-    threads[t].start(callback(tasks[t].func, tasks[t].args));
-
-    // The task ID must correspond with its position within the task array
-    assert(t == tasks[t].id);
+    // Queued tasks are started by the events task instead
+    if (tasks[t].func != NULL) {
+      // threads[t].set_priority(tasks[t].priority);
+      threads[t].start(callback(tasks[t].func, tasks[t].args));
+    }
 
     // Print amount of heap used
     // print_heap_and_isr_stack_info();
   }
 
+  // Shows where boot time went, and how soon the ESCs were commanded
+  boot_trace_print(targs->serial);
+
   // Wait for all tasks to complete
   for (t = 0; t < NUM_TASKS; t++) {
-    threads[t].join();
+    if (tasks[t].func != NULL) {
+      threads[t].join();
+    }
   }
 
 
-  delete(targs->mutex.pc_serial);
+  delete(targs->mutex.esp_serial);
   delete(targs->mutex.controls);
   delete(targs->mutex.outputs);
   delete(targs->mutex.telemetry);
 
+  free(targs->flight_log);
+
   delete(targs->esp_ready_pin);
   delete(targs->wdt);
   delete(command_queue);
+  delete(safety_command_queue);
   delete(serial);
+  delete(targs->mutex.pc_serial);
 
   free(targs);
 }
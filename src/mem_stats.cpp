@@ -0,0 +1,107 @@
+/* Copyright (c) 2018 Cameron A. Craig, MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ * BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * @file mem_stats.cpp
+ * @author Cameron A. Craig
+ * @date 12 Mar 2018
+ * @copyright 2018 Cameron A. Craig
+ * @brief Heap and stack usage, sampled for the mem command and telemetry.
+ */
+
+#include "mbed.h"
+#include "mem_stats.h"
+#include "task_control.h"
+#include "tasks.h"
+
+/* ISR stack bounds, set up by mbed_boot.c */
+extern "C" {
+extern unsigned char *mbed_stack_isr_start;
+extern uint32_t mbed_stack_isr_size;
+}
+
+/* Written into unused ISR stack, anything else has been overwritten */
+#define MEM_STACK_FILL 0xE25A2EA5UL
+
+/* Leave this much below the live top of the ISR stack untouched */
+#define MEM_STACK_FILL_GUARD 64
+
+static mem_stats_t mem_stats;
+
+void mem_stats_init(void) {
+  uint32_t *word = (uint32_t *) mbed_stack_isr_start;
+
+  // The ISR stack grows down, so the free part is at the start
+  core_util_critical_section_enter();
+  uint32_t *top = (uint32_t *) (__get_MSP() - MEM_STACK_FILL_GUARD);
+  while (word < top) {
+    *word++ = MEM_STACK_FILL;
+  }
+  core_util_critical_section_exit();
+}
+
+/**
+* @brief Measure the deepest the ISR stack has been since mem_stats_init().
+*/
+static uint32_t mem_isr_stack_peak(void) {
+  const uint32_t *word = (const uint32_t *) mbed_stack_isr_start;
+  const uint32_t *end = (const uint32_t *) (mbed_stack_isr_start + mbed_stack_isr_size);
+
+  while (word < end && *word == MEM_STACK_FILL) {
+    word++;
+  }
+  return (uint32_t) ((const unsigned char *) end - (const unsigned char *) word);
+}
+
+void mem_stats_sample(thread_args_t *targs) {
+  mbed_stats_heap_t heap;
+  mem_stats_t sample;
+  unsigned t;
+
+  mbed_stats_heap_get(&heap);
+  sample.heap_current = heap.current_size;
+  sample.heap_peak = heap.max_size;
+  sample.heap_reserved = heap.reserved_size;
+  sample.alloc_count = heap.alloc_cnt;
+  sample.alloc_failures = heap.alloc_fail_cnt;
+
+  sample.isr_stack_size = mbed_stack_isr_size;
+  sample.isr_stack_peak = mem_isr_stack_peak();
+
+  sample.task_stack_peak_id = 0;
+  sample.task_stack_peak_percent = 0;
+  for (t = 0; t < NUM_TASKS; t++) {
+    // Queued tasks share the events task's stack
+    if (targs->tasks[t].stack_size == 0) {
+      continue;
+    }
+    uint32_t percent = (targs->tasks[t].stack_peak * 100) / targs->tasks[t].stack_size;
+    if (percent > sample.task_stack_peak_percent) {
+      sample.task_stack_peak_id = t;
+      sample.task_stack_peak_percent = percent;
+    }
+  }
+
+  core_util_critical_section_enter();
+  mem_stats = sample;
+  core_util_critical_section_exit();
+}
+
+void mem_stats_get(mem_stats_t *stats) {
+  core_util_critical_section_enter();
+  *stats = mem_stats;
+  core_util_critical_section_exit();
+}
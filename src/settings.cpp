@@ -0,0 +1,213 @@
+/* Copyright (c) 2018 Cameron A. Craig, MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ * BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * @file settings.cpp
+ * @author Cameron A. Craig
+ * @date 8 Mar 2018
+ * @copyright 2018 Cameron A. Craig
+ * @brief Tunable parameters that can be changed at run time.
+ */
+
+#include "mbed.h"
+#include "rtos.h"
+#include "settings.h"
+#include "lookup.h"
+#include "return_codes.h"
+#include "warm_start.h"
+
+#define SETTING_ENTRY(id, name, type, field, def, min, max) \
+  {id, name, type, offsetof(settings_t, field), def, min, max},
+
+static const setting_t settings_table[NUM_SETTINGS] = {
+  SETTINGS(SETTING_ENTRY)
+};
+
+/* Readers copy whichever buffer is active, the writer fills the other one
+   and then swaps. The generation changes on every swap, so a reader that was
+   preempted for long enough to see its buffer reused knows to try again. */
+static settings_t buffers[2];
+static settings_t * volatile active = &buffers[0];
+static volatile uint32_t generation;
+
+/* Only one writer at a time. */
+static Mutex edit_mutex;
+static settings_t *editing;
+
+static lookup_table_t settings_lookup;
+
+static const char * setting_name(unsigned index) {
+  return settings_table[index].name;
+}
+
+/**
+* @brief Write a value into a settings buffer, as the setting's type.
+*/
+static void setting_store(settings_t *settings, const setting_t *setting, const tele_value_t *value) {
+  void *field = (uint8_t *) settings + setting->offset;
+  if (setting->type == CT_FLOAT) {
+    memcpy(field, &value->f, sizeof(float));
+  } else {
+    memcpy(field, &value->i, sizeof(int));
+  }
+}
+
+bool settings_init(void) {
+  unsigned i;
+  tele_value_t value;
+
+  for (i = 0; i < NUM_SETTINGS; i++) {
+    if (settings_table[i].type == CT_FLOAT) {
+      value.f = settings_table[i].def;
+    } else {
+      value.i = (int) settings_table[i].def;
+    }
+    setting_store(&buffers[0], &settings_table[i], &value);
+  }
+  active = &buffers[0];
+
+  return lookup_build(&settings_lookup, setting_name, NUM_SETTINGS);
+}
+
+void settings_read(settings_t *settings) {
+  uint32_t start_generation;
+  do {
+    start_generation = generation;
+    __DMB();
+    memcpy(settings, (const void *) active, sizeof(settings_t));
+    __DMB();
+  } while (start_generation != generation);
+}
+
+const setting_t * setting_get(unsigned id) {
+  if (id >= NUM_SETTINGS) {
+    return NULL;
+  }
+  return &settings_table[id];
+}
+
+const setting_t * setting_find(const char *name, size_t len) {
+  int index = lookup_find(&settings_lookup, name, len);
+  return (index < 0) ? NULL : &settings_table[index];
+}
+
+void setting_value(const setting_t *setting, tele_value_t *value) {
+  settings_t settings;
+  settings_read(&settings);
+
+  const void *field = (const uint8_t *) &settings + setting->offset;
+  if (setting->type == CT_FLOAT) {
+    memcpy(&value->f, field, sizeof(float));
+  } else {
+    memcpy(&value->i, field, sizeof(int));
+  }
+}
+
+bool setting_needs_disarm(const setting_t *setting) {
+  switch (setting->id) {
+    case SETTING_DRIVE_MODE:
+    case SETTING_WEAPON_MODE:
+      return true;
+    default:
+      return false;
+  }
+}
+
+/**
+* @brief Check a value against a setting's range.
+*/
+static bool setting_in_range(const setting_t *setting, float v) {
+  // NaN fails both comparisons, so is rejected too
+  return v >= setting->min && v <= setting->max;
+}
+
+int setting_set(const setting_t *setting, const tele_value_t *value) {
+  float v = (setting->type == CT_FLOAT) ? value->f : (float) value->i;
+
+  if (!setting_in_range(setting, v)) {
+    return RET_OUT_OF_RANGE;
+  }
+
+  settings_t *settings = settings_edit_begin();
+  setting_store(settings, setting, value);
+  return settings_edit_commit();
+}
+
+int settings_validate(const settings_t *settings) {
+  unsigned i;
+  int rc, ch;
+
+  for (i = 0; i < NUM_SETTINGS; i++) {
+    const void *field = (const uint8_t *) settings + settings_table[i].offset;
+    float v;
+    if (settings_table[i].type == CT_FLOAT) {
+      memcpy(&v, field, sizeof(float));
+    } else {
+      int n;
+      memcpy(&n, field, sizeof(int));
+      v = (float) n;
+    }
+    if (!setting_in_range(&settings_table[i], v)) {
+      return RET_OUT_OF_RANGE;
+    }
+  }
+
+  if (settings->stick_centre_min >= settings->stick_centre_max) {
+    return RET_CONFLICT;
+  }
+  for (rc = 0; rc < RC_NUMBER_CONTROLLERS; rc++) {
+    for (ch = 0; ch < RC_NUMBER_CHANNELS; ch++) {
+      if (settings->channel_limits[rc][ch].min >= settings->channel_limits[rc][ch].max) {
+        return RET_CONFLICT;
+      }
+    }
+  }
+  if (settings->weapon_spinup_rpm >= settings->weapon_rpm_max) {
+    return RET_CONFLICT;
+  }
+  return RET_OK;
+}
+
+settings_t * settings_edit_begin(void) {
+  edit_mutex.lock();
+  editing = (active == &buffers[0]) ? &buffers[1] : &buffers[0];
+  memcpy(editing, (const void *) active, sizeof(settings_t));
+  return editing;
+}
+
+int settings_edit_commit(void) {
+  // Readers never see the edit buffer, so a refused edit is just dropped
+  int ret = settings_validate(editing);
+  if (ret != RET_OK) {
+    edit_mutex.unlock();
+    return ret;
+  }
+
+  // The new values must be in memory before readers can find them
+  __DMB();
+  active = editing;
+  generation++;
+  __DMB();
+  warm_start_save_settings(editing);
+  edit_mutex.unlock();
+  return RET_OK;
+}
+
+int settings_restore(const settings_t *settings) {
+  settings_t *edit = settings_edit_begin();
+  memcpy(edit, settings, sizeof(settings_t));
+  return settings_edit_commit();
+}
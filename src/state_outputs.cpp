@@ -0,0 +1,203 @@
+/* Copyright (c) 2018 Cameron A. Craig, MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ * BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * @file state_outputs.cpp
+ * @author Cameron A. Craig
+ * @date 21 Mar 2018
+ * @copyright 2018 Cameron A. Craig
+ * @brief Everything that follows the arming state, told of each change rather than polling it.
+ */
+
+#include "mbed.h"
+#include "state_outputs.h"
+#include "states.h"
+#include "tele_params.h"
+#include "utilc-logging.h"
+
+/* Subscribers run in the context of whoever raised the event, see
+   state_subscribe(), and everything here is a few register writes. Each one
+   reads the state and applies it in a critical section, so if two changes
+   race, whichever is applied last still shows the newest state. */
+
+static thread_args_t *outputs_args = NULL;
+
+/* Set by esc_gate_shut(), the gate then stays closed whatever the state */
+static bool esc_gate_shut_down = false;
+
+static Ticker led_ripple_timer;
+static bool led_ripple[NUM_SURFACE_LEDS];
+
+uint32_t esc_gate_for_state(state_t state) {
+  switch (state) {
+    case STATE_FULLY_ARMED:
+      return ESC_GATE_DRIVE | ESC_GATE_WEAPON;
+    case STATE_DRIVE_ONLY:
+      return ESC_GATE_DRIVE;
+    case STATE_WEAPON_ONLY:
+      return ESC_GATE_WEAPON;
+    case STATE_DISARMED:
+    default:
+      return 0;
+  }
+}
+
+void esc_gate_stop(thread_args_t *args, uint32_t outputs) {
+  unsigned i;
+  for (i = 0; i < 3; i++) {
+    if (outputs & (1U << (COMMS_OUTPUT_DRIVE_1 + i))) {
+      args->comms_impl->stop(&args->escs.drive[i]);
+    }
+    if (outputs & (1U << (COMMS_OUTPUT_WEAPON_1 + i))) {
+      args->comms_impl->stop(&args->escs.weapon[i]);
+    }
+  }
+}
+
+/**
+* @brief Open or close the ESC gate to match the state.
+* @details Any ESC the gate closes is stopped here and now, rather than on the
+*          next control loop iteration.
+*/
+static void esc_gate_update(void *context, const state_transition_t *transition) {
+  thread_args_t *args = (thread_args_t *) context;
+
+  core_util_critical_section_enter();
+  uint32_t gate = esc_gate_shut_down ? 0 : esc_gate_for_state(args->state);
+  uint32_t closed = args->esc_gate & ~gate;
+  args->esc_gate = gate;
+  core_util_critical_section_exit();
+
+  // set_output_escs() checks the gate again after writing, in case this
+  // ran part way through
+  esc_gate_stop(args, closed);
+}
+
+void esc_gate_shut(thread_args_t *args) {
+  core_util_critical_section_enter();
+  esc_gate_shut_down = true;
+  uint32_t closed = args->esc_gate;
+  args->esc_gate = 0;
+  core_util_critical_section_exit();
+
+  esc_gate_stop(args, closed);
+}
+
+/**
+* @brief Move the weapon only ripple along by one LED.
+*/
+static void led_ripple_step(void) {
+  unsigned l;
+  for (l = 0; l < NUM_SURFACE_LEDS; l++) {
+    outputs_args->leds[l]->write(led_ripple[l]);
+  }
+
+  bool last = led_ripple[NUM_SURFACE_LEDS - 1];
+  memmove(&led_ripple[1], &led_ripple[0], sizeof(bool) * (NUM_SURFACE_LEDS - 1));
+  led_ripple[0] = last;
+}
+
+/**
+* @brief Show the state on the LEDs.
+* @details Drive only lights the first two, fully armed lights all four and
+*          weapon only ripples a single LED along the row.
+*/
+static void leds_update(void *context, const state_transition_t *transition) {
+  thread_args_t *args = (thread_args_t *) context;
+  unsigned l;
+
+  core_util_critical_section_enter();
+  led_ripple_timer.detach();
+
+  switch (args->state) {
+    case STATE_WEAPON_ONLY:
+      memset(led_ripple, 0x00, sizeof(led_ripple));
+      led_ripple[0] = true;
+      led_ripple_step();
+      led_ripple_timer.attach_us(&led_ripple_step, LED_RIPPLE_PERIOD_MS * 1000);
+      break;
+    case STATE_DRIVE_ONLY:
+      for (l = 0; l < NUM_SURFACE_LEDS; l++) {
+        args->leds[l]->write(l < 2);
+      }
+      break;
+    case STATE_FULLY_ARMED:
+      for (l = 0; l < NUM_SURFACE_LEDS; l++) {
+        args->leds[l]->write(true);
+      }
+      break;
+    case STATE_DISARMED:
+    default:
+      for (l = 0; l < NUM_SURFACE_LEDS; l++) {
+        args->leds[l]->write(false);
+      }
+      break;
+  }
+  core_util_critical_section_exit();
+}
+
+/**
+* @brief Publish the state as the arm_status telemetry parameter.
+* @details A single word, so it is written without the telemetry mutex, which
+*          cannot be taken from an ISR.
+*/
+static void telemetry_update(void *context, const state_transition_t *transition) {
+  thread_args_t *args = (thread_args_t *) context;
+  core_util_critical_section_enter();
+  tele_commands[CID_ARM_STATUS].param.i = args->state;
+  core_util_critical_section_exit();
+}
+
+/**
+* @brief Have the next flight log record taken straight away, so the change
+*        is logged within one control loop iteration, and write the log to
+*        file only while disarmed.
+*/
+static void flight_log_update(void *context, const state_transition_t *transition) {
+  thread_args_t *args = (thread_args_t *) context;
+  if (args->flight_log != NULL) {
+    core_util_critical_section_enter();
+    flight_log_hold(args->flight_log, args->state != STATE_DISARMED);
+    core_util_critical_section_exit();
+    args->flight_log->state_changed = true;
+  }
+}
+
+/**
+* @brief Report the change on the console.
+*/
+static void log_update(void *context, const state_transition_t *transition) {
+  LOG_INFO("state change: %s --> %s (%s)\r\n",
+    state_to_str(transition->from),
+    state_to_str(transition->to),
+    state_event_to_str(transition->event));
+}
+
+void state_outputs_init(thread_args_t *args) {
+  outputs_args = args;
+
+  // The gate first, so a disarm reaches the ESCs before anything else
+  state_subscribe(esc_gate_update, args);
+  state_subscribe(leds_update, args);
+  state_subscribe(telemetry_update, args);
+  state_subscribe(flight_log_update, args);
+  state_subscribe(log_update, args);
+
+  // The state may already have been restored after a watchdog reset
+  esc_gate_update(args, NULL);
+  leds_update(args, NULL);
+  telemetry_update(args, NULL);
+}
@@ -19,10 +19,55 @@
  * @author Cameron A. Craig
  * @date 18 May 2017
  * @copyright 2017 Cameron A. Craig
- * @brief State machine
+ * @brief Arming state machine, every change of state is made and published here.
  */
 
+#include "mbed.h"
 #include "states.h"
+#include "config.h"
+#include "return_codes.h"
+
+#define S_DIS STATE_DISARMED
+#define S_DRV STATE_DRIVE_ONLY
+#define S_WPN STATE_WEAPON_ONLY
+#define S_ARM STATE_FULLY_ARMED
+
+/**
+ * Next state for each event (row) in each current state (column). An entry
+ * equal to its column means the event has no effect in that state.
+ */
+static const state_t state_table[NUM_STATE_EVENTS][NUM_STATES] = {
+  /*                                       DIS    DRV    WPN    ARM */
+  /* STATE_EVENT_DRIVE_SWITCH_OFF       */ {S_DIS, S_DIS, S_WPN, S_WPN},
+  /* STATE_EVENT_WEAPON_SWITCH_OFF      */ {S_DIS, S_DRV, S_DIS, S_DRV},
+  /* STATE_EVENT_DRIVE_READY            */ {S_DRV, S_DRV, S_ARM, S_ARM},
+  /* STATE_EVENT_WEAPON_READY           */ {S_WPN, S_ARM, S_WPN, S_ARM},
+  /* STATE_EVENT_DRIVE_STALL            */ {S_DIS, S_DIS, S_WPN, S_WPN},
+  /* STATE_EVENT_WEAPON_STALL           */ {S_DIS, S_DRV, S_DIS, S_DRV},
+  /* STATE_EVENT_COMMAND_DISARM         */ {S_DIS, S_DIS, S_DIS, S_DIS},
+  /* STATE_EVENT_COMMAND_PARTIAL_DISARM */ {S_DIS, S_DIS, S_DRV, S_WPN},
+  /* STATE_EVENT_COMMAND_PARTIAL_ARM    */ {S_DRV, S_WPN, S_ARM, S_ARM},
+  /* STATE_EVENT_COMMAND_ARM            */ {S_ARM, S_ARM, S_ARM, S_ARM},
+  /* STATE_EVENT_WATCHDOG_DRIVE         */ {S_DRV, S_DRV, S_ARM, S_ARM},
+  /* STATE_EVENT_WATCHDOG_WEAPON        */ {S_WPN, S_ARM, S_WPN, S_ARM},
+};
+
+#undef S_DIS
+#undef S_DRV
+#undef S_WPN
+#undef S_ARM
+
+typedef struct {
+  state_subscriber_t subscriber;
+  void *context;
+} state_subscription_t;
+
+static state_subscription_t state_subscriptions[STATE_MAX_SUBSCRIBERS];
+static unsigned state_num_subscriptions = 0;
+
+static state_transition_t state_log[STATE_HISTORY_LEN];
+/* Number of changes recorded, the newest is at (state_count - 1) */
+static volatile uint32_t state_count = 0;
 
 const char * state_to_str(state_t state) {
   switch (state) {
@@ -38,3 +83,108 @@ const char * state_to_str(state_t state) {
       return "INVALID_STATE";
   }
 }
+
+const char * state_event_to_str(state_event_t event) {
+  switch (event) {
+    case STATE_EVENT_DRIVE_SWITCH_OFF:
+      return "drive switch off";
+    case STATE_EVENT_WEAPON_SWITCH_OFF:
+      return "weapon switch off";
+    case STATE_EVENT_DRIVE_READY:
+      return "drive switch on";
+    case STATE_EVENT_WEAPON_READY:
+      return "weapon switch on";
+    case STATE_EVENT_DRIVE_STALL:
+      return "drive stall";
+    case STATE_EVENT_WEAPON_STALL:
+      return "weapon stall";
+    case STATE_EVENT_COMMAND_DISARM:
+      return "disarm command";
+    case STATE_EVENT_COMMAND_PARTIAL_DISARM:
+      return "partial disarm command";
+    case STATE_EVENT_COMMAND_PARTIAL_ARM:
+      return "partial arm command";
+    case STATE_EVENT_COMMAND_ARM:
+      return "arm command";
+    case STATE_EVENT_WATCHDOG_DRIVE:
+      return "watchdog restore drive";
+    case STATE_EVENT_WATCHDOG_WEAPON:
+      return "watchdog restore weapon";
+    default:
+      return "INVALID_EVENT";
+  }
+}
+
+/**
+* @brief Add a change to the history.
+* @details Changes raised at the same moment from different contexts may be
+*          recorded in either order, but each record holds both states, so
+*          the sequence can still be followed.
+*/
+static void state_record(const state_transition_t *transition) {
+  core_util_critical_section_enter();
+  state_log[state_count % STATE_HISTORY_LEN] = *transition;
+  state_count++;
+  core_util_critical_section_exit();
+}
+
+bool state_raise(volatile state_t *state, state_event_t event) {
+  uint32_t from, to;
+
+  if (event >= NUM_STATE_EVENTS) {
+    return false;
+  }
+
+  do {
+    from = *state;
+    if (from >= NUM_STATES) {
+      return false;
+    }
+    to = state_table[event][from];
+    if (to == from) {
+      return false;
+    }
+    // Fails, and looks up the change again, if the state moved meanwhile
+  } while (!core_util_atomic_cas_u32((volatile uint32_t *) state, &from, to));
+
+  state_transition_t transition;
+  transition.time_ms = us_ticker_read() / 1000;
+  transition.event = event;
+  transition.from = (state_t) from;
+  transition.to = (state_t) to;
+  state_record(&transition);
+
+  unsigned s;
+  for (s = 0; s < state_num_subscriptions; s++) {
+    state_subscriptions[s].subscriber(state_subscriptions[s].context, &transition);
+  }
+  return true;
+}
+
+int state_subscribe(state_subscriber_t subscriber, void *context) {
+  if (state_num_subscriptions >= STATE_MAX_SUBSCRIBERS) {
+    return RET_ERROR;
+  }
+  state_subscriptions[state_num_subscriptions].subscriber = subscriber;
+  state_subscriptions[state_num_subscriptions].context = context;
+  state_num_subscriptions++;
+  return RET_OK;
+}
+
+unsigned state_history(state_transition_t *history, unsigned len) {
+  unsigned n = 0;
+
+  core_util_critical_section_enter();
+  uint32_t count = state_count;
+  while (n < len && n < STATE_HISTORY_LEN && n < count) {
+    history[n] = state_log[(count - 1 - n) % STATE_HISTORY_LEN];
+    n++;
+  }
+  core_util_critical_section_exit();
+
+  return n;
+}
+
+uint32_t state_transitions(void) {
+  return state_count;
+}
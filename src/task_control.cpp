@@ -0,0 +1,376 @@
+/* Copyright (c) 2018 Cameron A. Craig, MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ * BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * @file task_control.cpp
+ * @author Cameron A. Craig
+ * @date 5 Mar 2018
+ * @copyright 2018 Cameron A. Craig
+ * @brief Run time task statistics and control.
+ */
+
+#include <ctype.h>
+#include "mbed.h"
+#include "rtos.h"
+#include "task_control.h"
+#include "thread_args.h"
+#include "tasks.h"
+
+/* Bit n is set each time task n finishes an iteration */
+static volatile uint32_t task_heartbeats = 0;
+
+/* One heartbeat bit per task */
+typedef char task_heartbeats_fit[(NUM_TASKS <= 32) ? 1 : -1];
+
+/* One priority level per periodic task below osPriorityHigh, so no two
+   deadlines are ever clamped onto the same level */
+typedef char task_priority_levels_fit[(osPriorityHigh - TASK_PRIORITY_PERIODIC_MIN >= (int) NUM_PERIODIC_TASKS) ? 1 : -1];
+
+/* Only written by the kernel's context switch, which cannot preempt itself */
+static volatile uint32_t task_switches = 0;
+
+/**
+* @brief RTX5 event recorder hook, called each time the running thread is
+*        switched. The library version is weak and only records the event.
+*/
+extern "C" void EvrRtxThreadSwitched(osThreadId_t thread_id) {
+  task_switches++;
+}
+
+void task_control_init(void) {
+  // The DWT cycle counter is part of the Cortex-M3 debug unit
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CYCCNT = 0;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+uint32_t task_context_switches(void) {
+  return task_switches;
+}
+
+uint32_t task_iteration_begin(task_t *task) {
+  uint32_t now_us = us_ticker_read();
+  task->stats.last_run_us = now_us;
+  task->stats.has_run = true;
+
+  // Event driven tasks are due as soon as they wake
+  if (!task->stats.released) {
+    task->stats.release_us = now_us;
+    task->stats.released = true;
+  }
+
+  uint32_t jitter_us = now_us - task->stats.release_us;
+  if (jitter_us > task->stats.worst_jitter_us) {
+    task->stats.worst_jitter_us = jitter_us;
+  }
+  return DWT->CYCCNT;
+}
+
+void task_release(task_t *task, uint32_t release_us) {
+  task->stats.release_us = release_us;
+  task->stats.released = true;
+}
+
+/**
+* @brief Deadline of a task in microseconds, 0 if it has none.
+*/
+static uint32_t task_deadline_us(const task_t *task) {
+  return (task->deadline_ms != 0 ? task->deadline_ms : task->period_ms) * 1000;
+}
+
+void task_iteration_end(task_t *task, uint32_t start_cycles) {
+  // Unsigned subtraction copes with the counter wrapping
+  uint32_t cycles = DWT->CYCCNT - start_cycles;
+
+  task->stats.iterations++;
+  task->stats.busy_cycles += cycles;
+  if (cycles > task->stats.max_cycles) {
+    task->stats.max_cycles = cycles;
+  }
+
+  uint32_t response_us = us_ticker_read() - task->stats.release_us;
+  uint32_t deadline_us = task_deadline_us(task);
+  if (deadline_us > 0 && response_us > deadline_us) {
+    task->stats.deadline_misses++;
+  }
+  if (response_us > task->stats.worst_response_us) {
+    task->stats.worst_response_us = response_us;
+  }
+  task->stats.released = false;
+
+  // Atomic OR, as any task may be setting its bit at the same time
+  uint32_t heartbeats;
+  do {
+    heartbeats = __LDREXW(&task_heartbeats) | (1UL << task->id);
+  } while (__STREXW(heartbeats, &task_heartbeats) != 0);
+}
+
+uint32_t task_heartbeats_take(void) {
+  uint32_t heartbeats;
+  do {
+    heartbeats = __LDREXW(&task_heartbeats);
+  } while (__STREXW(0, &task_heartbeats) != 0);
+  return heartbeats;
+}
+
+void task_sleep(task_t *task) {
+  if (!task->active) {
+    task_park(task);
+    return;
+  }
+
+  /* Release on a fixed grid rather than a fixed gap after each iteration,
+     so the time taken by the iteration does not stretch the period. */
+  uint32_t now_us = us_ticker_read();
+  uint32_t next_us = task->stats.release_us + task->period_ms * 1000;
+  int32_t delay_us = (int32_t) (next_us - now_us);
+
+  if (delay_us > 0) {
+    // Round up, waking early would shorten the period
+    Thread::wait((delay_us + 999) / 1000);
+    task->stats.release_us = next_us;
+  } else {
+    // Overran into the next period, start the grid again from now
+    task->stats.release_us = now_us;
+  }
+  task->stats.released = true;
+}
+
+void task_park(task_t *task) {
+  /* The signal stays set if it arrives before we wait, so a task started
+     between the check and the wait is not missed. */
+  while (!task->active) {
+    Thread::signal_wait(TASK_WAKE_SIGNAL);
+  }
+  // Time spent parked is not a late response
+  task->stats.released = false;
+}
+
+/**
+* @brief Deadline used to rank a task, 0 if it keeps its own priority.
+*/
+static uint32_t task_rank_deadline(const task_t *task) {
+  // Queued tasks run at the priority of the events thread
+  if (task->period_ms == 0 || task->priority < osPriorityNormal || task->step != NULL) {
+    return 0;
+  }
+  return task_deadline_us(task);
+}
+
+void task_assign_priorities(task_t *tasks, unsigned num_tasks) {
+  unsigned i, j;
+
+  for (i = 0; i < num_tasks; i++) {
+    uint32_t deadline = task_rank_deadline(&tasks[i]);
+    if (deadline == 0) {
+      continue;
+    }
+
+    // Count the distinct deadlines shorter than this one
+    unsigned rank = 0;
+    for (j = 0; j < num_tasks; j++) {
+      uint32_t other = task_rank_deadline(&tasks[j]);
+      if (other == 0 || other >= deadline) {
+        continue;
+      }
+      unsigned k;
+      bool seen = false;
+      for (k = 0; k < j; k++) {
+        if (task_rank_deadline(&tasks[k]) == other) {
+          seen = true;
+          break;
+        }
+      }
+      if (!seen) {
+        rank++;
+      }
+    }
+
+    int priority = osPriorityHigh - 1 - (int) rank;
+    if (priority < TASK_PRIORITY_PERIODIC_MIN) {
+      priority = TASK_PRIORITY_PERIODIC_MIN;
+    }
+    tasks[i].priority = (osPriority) priority;
+  }
+}
+
+void task_set_active(thread_args_t *targs, unsigned id, bool active) {
+#ifdef TASK_CALIBRATE_CHANNELS
+  // Never carry on from part way through an earlier calibration
+  if (id == TASK_CALIBRATE_CHANNELS_ID) {
+    task_calibrate_channels_restart();
+  }
+#endif
+  targs->tasks[id].active = active;
+  if (!active) {
+    return;
+  }
+#ifdef TASK_EVENTS
+  if (targs->tasks[id].step != NULL) {
+    task_events_schedule(id);
+    return;
+  }
+#endif
+  targs->threads[id].signal_set(TASK_WAKE_SIGNAL);
+}
+
+bool task_stack_sample(thread_args_t *targs, unsigned id) {
+  /* max_stack() is the high water mark of the stack fill pattern
+     (MBED_STACK_STATS_ENABLED), used_stack() only the current depth */
+  uint32_t used = targs->threads[id].max_stack();
+  if (used <= targs->tasks[id].stack_peak) {
+    return false;
+  }
+  targs->tasks[id].stack_peak = used;
+  return true;
+}
+
+uint32_t task_stack_recommended(const task_t *task) {
+  uint32_t size = task->stack_peak + (task->stack_peak * STACK_MARGIN_PERCENT) / 100;
+  // Stacks must stay 8 byte aligned
+  return (size + 7) & ~7UL;
+}
+
+bool task_stack_low(const task_t *task) {
+  return task->stack_peak > task->stack_size - (task->stack_size * STACK_MARGIN_PERCENT) / 100;
+}
+
+void task_stats_take(task_t *task, task_stats_t *stats) {
+  core_util_critical_section_enter();
+  stats->iterations = task->stats.iterations;
+  stats->busy_cycles = task->stats.busy_cycles;
+  stats->max_cycles = task->stats.max_cycles;
+  stats->last_run_us = task->stats.last_run_us;
+  stats->has_run = task->stats.has_run;
+  stats->deadline_misses = task->stats.deadline_misses;
+  stats->worst_response_us = task->stats.worst_response_us;
+  stats->worst_jitter_us = task->stats.worst_jitter_us;
+  task->stats.iterations = 0;
+  task->stats.busy_cycles = 0;
+  task->stats.max_cycles = 0;
+  core_util_critical_section_exit();
+}
+
+/**
+* @brief Compare a task name with a command token.
+*/
+static bool task_name_matches(const char *task_name, const char *name, size_t len) {
+  size_t i;
+  for (i = 0; i < len; i++) {
+    char c = name[i];
+    if (task_name[i] == '\0') {
+      return false;
+    }
+    if (c == '_' || c == '-') {
+      c = ' ';
+    }
+    if (tolower((unsigned char) c) != tolower((unsigned char) task_name[i])) {
+      return false;
+    }
+  }
+  return task_name[len] == '\0';
+}
+
+int task_find(const char *name, size_t len) {
+  unsigned i;
+  unsigned id = 0;
+
+  // A decimal ID, as shown by "task list"
+  for (i = 0; i < len && isdigit((unsigned char) name[i]); i++) {
+    id = id * 10 + (name[i] - '0');
+  }
+  if (len > 0 && i == len) {
+    return (id < NUM_TASKS) ? (int) id : -1;
+  }
+
+  for (i = 0; i < NUM_TASKS; i++) {
+    if (task_name_matches(tasks[i].name, name, len)) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+bool task_stoppable(unsigned id) {
+#ifdef TASK_READ_SERIAL
+  if (id == TASK_READ_SERIAL_ID) {
+    return false;
+  }
+#endif
+#ifdef TASK_PROCESS_COMMANDS
+  if (id == TASK_PROCESS_COMMANDS_ID) {
+    return false;
+  }
+#endif
+#ifdef TASK_SAFETY_COMMANDS
+  if (id == TASK_SAFETY_COMMANDS_ID) {
+    return false;
+  }
+#endif
+#ifdef TASK_EVENTS
+  // Runs dispatch_forever() and never parks, so a stop would do nothing
+  if (id == TASK_EVENTS_ID) {
+    return false;
+  }
+#endif
+#ifdef TASK_MOTOR_DRIVE
+  if (id == TASK_MOTOR_DRIVE_ID) {
+    return false;
+  }
+#endif
+#ifdef TASK_FAILSAFE
+  // A parked failsafe would also be exempt from the supervisor
+  if (id == TASK_FAILSAFE_ID) {
+    return false;
+  }
+#endif
+#ifdef TASK_EXECUTIVE
+  if (id == TASK_EXECUTIVE_ID) {
+    return false;
+  }
+#endif
+#ifdef TASK_SUPERVISOR
+  if (id == TASK_SUPERVISOR_ID) {
+    return false;
+  }
+#endif
+#ifdef TASK_LOG
+  // LOG() would wait for it forever
+  if (id == TASK_LOG_ID) {
+    return false;
+  }
+#endif
+  return id < NUM_TASKS;
+}
+
+bool task_gates_outputs(unsigned id) {
+#ifdef TASK_ARMING
+  if (id == TASK_ARMING_ID) {
+    return true;
+  }
+#endif
+#if defined(TASK_CALC_ORIENTATION) && defined(DEVICE_BNO055)
+  if (id == TASK_CALC_ORIENTATION_ID) {
+    return true;
+  }
+#endif
+#ifdef TASK_CALIBRATE_CHANNELS
+  if (id == TASK_CALIBRATE_CHANNELS_ID) {
+    return true;
+  }
+#endif
+  return false;
+}
@@ -25,8 +25,12 @@
 #include "thread_args.h"
 #include "tmath.h"
 #include "comms.h"
+#include "flight_log.h"
+#include "boot_trace.h"
+#include "state_outputs.h"
+#include "esc_cutoff.h"
 
-void read_recv_pw(thread_args_t *args) {
+void read_recv_pw(thread_args_t *args, const settings_t *settings) {
   int controller, channel;
   float pw, v, min, max;
 
@@ -36,8 +40,8 @@ void read_recv_pw(thread_args_t *args) {
       pw = args->receiver[controller].channel[channel]->pulsewidth();
 
       // Get min and max pulsewidths fot this channel
-      min = args->channel_limits[controller][channel].min;
-      max = args->channel_limits[controller][channel].max;
+      min = settings->channel_limits[controller][channel].min;
+      max = settings->channel_limits[controller][channel].max;
 
       // Make sure pw doesn't leave bounds due to imperfect calibration
       pw = clamp(pw, min, max);
@@ -68,40 +72,67 @@ void set_output_escs(thread_args_t *args) {
   args->outputs.weapon_motor_3 = clamp(args->outputs.weapon_motor_3, 0, 100);
   args->mutex.outputs->unlock();
 
-  /* Now that we have valid output parameters, we can set the ESCs. */
+  /* Now that we have valid output parameters, we can set the ESCs that the
+     gate allows, and stop the rest. */
   args->mutex.outputs->lock();
-    switch (args->state) {
-      case STATE_FULLY_ARMED:
-        args->comms_impl->set_speed(&args->escs.weapon[0], args->outputs.weapon_motor_1);
-        args->comms_impl->set_speed(&args->escs.weapon[1], args->outputs.weapon_motor_2);
-        args->comms_impl->set_speed(&args->escs.weapon[2], args->outputs.weapon_motor_3);
-        args->comms_impl->set_speed(&args->escs.drive[0], args->outputs.wheel_1);
-        args->comms_impl->set_speed(&args->escs.drive[1], args->outputs.wheel_2);
-        args->comms_impl->set_speed(&args->escs.drive[2], args->outputs.wheel_3);
-        break;
-      case STATE_DRIVE_ONLY:
-        args->comms_impl->set_speed(&args->escs.drive[0], args->outputs.wheel_1);
-        args->comms_impl->set_speed(&args->escs.drive[1], args->outputs.wheel_2);
-        args->comms_impl->set_speed(&args->escs.drive[2], args->outputs.wheel_3);
-        args->comms_impl->stop(&args->escs.weapon[0]);
-        args->comms_impl->stop(&args->escs.weapon[1]);
-        args->comms_impl->stop(&args->escs.weapon[2]);
-        break;
-      case STATE_WEAPON_ONLY:
-        args->comms_impl->set_speed(&args->escs.weapon[0], args->outputs.weapon_motor_1);
-        args->comms_impl->set_speed(&args->escs.weapon[1], args->outputs.weapon_motor_2);
-        args->comms_impl->set_speed(&args->escs.weapon[2], args->outputs.weapon_motor_3);
-        args->comms_impl->stop(&args->escs.drive[0]);
-        args->comms_impl->stop(&args->escs.drive[1]);
-        args->comms_impl->stop(&args->escs.drive[2]);
-        break;
-      case STATE_DISARMED:
-        args->comms_impl->stop(&args->escs.drive[0]);
-        args->comms_impl->stop(&args->escs.drive[1]);
-        args->comms_impl->stop(&args->escs.drive[2]);
-        args->comms_impl->stop(&args->escs.weapon[0]);
-        args->comms_impl->stop(&args->escs.weapon[1]);
-        args->comms_impl->stop(&args->escs.weapon[2]);
+  // Outputs held by the cutoff interrupt stay stopped until disarmed
+  uint32_t gate = args->esc_gate & ~esc_cutoff_outputs();
+  if (gate & ESC_GATE_DRIVE) {
+    args->comms_impl->set_speed(&args->escs.drive[0], args->outputs.wheel_1);
+    args->comms_impl->set_speed(&args->escs.drive[1], args->outputs.wheel_2);
+    args->comms_impl->set_speed(&args->escs.drive[2], args->outputs.wheel_3);
+  }
+  if (gate & ESC_GATE_WEAPON) {
+    args->comms_impl->set_speed(&args->escs.weapon[0], args->outputs.weapon_motor_1);
+    args->comms_impl->set_speed(&args->escs.weapon[1], args->outputs.weapon_motor_2);
+    args->comms_impl->set_speed(&args->escs.weapon[2], args->outputs.weapon_motor_3);
+  }
+  /* A disarm or a cutoff stops the ESCs itself, but may have done so part
+     way through the writes above. */
+  esc_gate_stop(args, ~(args->esc_gate & ~esc_cutoff_outputs()));
+  args->mutex.outputs->unlock();
+
+  boot_trace_first_output();
+}
+
+void log_flight_record(thread_args_t *args) {
+  uint32_t now = us_ticker_read();
+  bool state_changed = args->flight_log->state_changed;
+  if (!state_changed && now - args->flight_log->last_record_us < FLIGHT_LOG_PERIOD_MS * 1000U) {
+    return;
+  }
+  args->flight_log->last_record_us = now;
+  args->flight_log->state_changed = false;
+
+  flight_log_record_t record;
+  int controller, channel;
+
+  record.time_us = now;
+  record.state = args->state;
+  record.flags = (args->inverted ? 0x01 : 0x00) | (state_changed ? 0x02 : 0x00);
+  record.reserved = 0;
+  record.esc_enabled = args->esc_gate & ~esc_cutoff_outputs();
+
+  args->mutex.controls->lock();
+  for (controller = 0; controller < RC_NUMBER_CONTROLLERS; controller++) {
+    for (channel = 0; channel < RC_NUMBER_CHANNELS; channel++) {
+      record.controls[controller][channel] = args->controls[controller].channel[channel];
     }
+  }
+  args->mutex.controls->unlock();
+
+  args->mutex.outputs->lock();
+  record.outputs[COMMS_OUTPUT_DRIVE_1] = args->outputs.wheel_1;
+  record.outputs[COMMS_OUTPUT_DRIVE_2] = args->outputs.wheel_2;
+  record.outputs[COMMS_OUTPUT_DRIVE_3] = args->outputs.wheel_3;
+  record.outputs[COMMS_OUTPUT_WEAPON_1] = args->outputs.weapon_motor_1;
+  record.outputs[COMMS_OUTPUT_WEAPON_2] = args->outputs.weapon_motor_2;
+  record.outputs[COMMS_OUTPUT_WEAPON_3] = args->outputs.weapon_motor_3;
   args->mutex.outputs->unlock();
+
+  record.heading = args->orientation.heading * 10.0f;
+  record.pitch = args->orientation.pitch * 10.0f;
+  record.roll = args->orientation.roll * 10.0f;
+
+  flight_log_append(args->flight_log, &record);
 }
@@ -23,6 +23,7 @@
  */
 
 #include "mbed.h"
+#include "mbed_events.h"
 #include "tasks.h"
 #include "bno055.h"
 #include "types.h"
@@ -34,17 +35,153 @@
 #include "return_codes.h"
 #include "tele_params.h"
 #include "utils.h"
+#include "esc_cutoff.h"
 #include "task_utils.h"
 #include "watchdog.h"
+#include "cli.h"
+#include "task_control.h"
+#include "mem_stats.h"
+#include "warm_start.h"
+#include "settings.h"
+#include "drive_modes.h"
+#include "state_outputs.h"
+
+/* Task stacks, allocated statically so the RAM they use is known at link
+   time. The sizes come from "task stack", see task_stack_monitor(). */
+#ifdef TASK_READ_SERIAL
+MBED_ALIGN(8) static unsigned char read_serial_stack[1024];
+#endif
+#ifdef TASK_PROCESS_COMMANDS
+MBED_ALIGN(8) static unsigned char process_commands_stack[2048];
+#endif
+#ifdef TASK_SAFETY_COMMANDS
+MBED_ALIGN(8) static unsigned char safety_commands_stack[2048];
+#endif
+#ifdef TASK_EVENTS
+// Holds the deepest of the queued tasks, see task_events()
+MBED_ALIGN(8) static unsigned char events_stack[2048];
+#endif
+#ifdef TASK_EXECUTIVE
+// Holds the deepest of the slots, the telemetry getters
+MBED_ALIGN(8) static unsigned char executive_stack[2048];
+#endif
+#ifdef TASK_MOTOR_DRIVE
+MBED_ALIGN(8) static unsigned char motor_drive_stack[1024];
+#endif
+#ifdef TASK_FAILSAFE
+MBED_ALIGN(8) static unsigned char failsafe_stack[1024];
+#endif
+#if defined(TASK_CALC_ORIENTATION) && defined(DEVICE_BNO055)
+MBED_ALIGN(8) static unsigned char calc_orientation_stack[2048];
+#endif
+#if defined(TASK_STREAM_TELEMETRY) && defined(DEVICE_ESP8266)
+MBED_ALIGN(8) static unsigned char stream_telemetry_stack[1024];
+#endif
+#ifdef TASK_FLIGHT_LOG
+MBED_ALIGN(8) static unsigned char flight_log_stack[2048];
+#endif
+#ifdef TASK_STACK_MONITOR
+MBED_ALIGN(8) static unsigned char stack_monitor_stack[1024];
+#endif
+#ifdef TASK_SUPERVISOR
+MBED_ALIGN(8) static unsigned char supervisor_stack[1024];
+#endif
+#ifdef TASK_LOG
+// Formats every message, including floats
+MBED_ALIGN(8) static unsigned char log_stack[2048];
+#endif
+#ifdef TASK_DEBUG
+MBED_ALIGN(8) static unsigned char debug_stack[1024];
+#endif
+
+volatile task_t tasks[NUM_TASKS] = {
+#ifdef TASK_READ_SERIAL
+  {.id = TASK_READ_SERIAL_ID,        .name = "Read Serial",        .func = task_read_serial,      .step = NULL,                         .args = NULL, .priority = osPriorityNormal,      .stack_size = sizeof(read_serial_stack),      .stack_mem = read_serial_stack,      .period_ms = 0,                          .heartbeat_ms = 0,    .active = true},
+#endif
+#ifdef TASK_PROCESS_COMMANDS
+  {.id = TASK_PROCESS_COMMANDS_ID,   .name = "Process Commands",   .func = task_process_commands, .step = NULL,                         .args = NULL, .priority = osPriorityBelowNormal, .stack_size = sizeof(process_commands_stack), .stack_mem = process_commands_stack, .period_ms = 0,                          .heartbeat_ms = 0,    .active = true},
+#endif
+#ifdef TASK_SAFETY_COMMANDS
+  {.id = TASK_SAFETY_COMMANDS_ID,    .name = "Safety Commands",    .func = task_safety_commands,  .step = NULL,                         .args = NULL, .priority = osPriorityHigh,        .stack_size = sizeof(safety_commands_stack),  .stack_mem = safety_commands_stack,  .period_ms = 0,                          .heartbeat_ms = 0,    .active = true},
+#endif
+#ifdef TASK_EVENTS
+  {.id = TASK_EVENTS_ID,             .name = "Events",             .func = task_events,           .step = NULL,                         .args = NULL, .priority = osPriorityNormal,      .stack_size = sizeof(events_stack),           .stack_mem = events_stack,           .period_ms = 0,                          .heartbeat_ms = 0,    .active = true},
+#endif
+#ifdef TASK_EXECUTIVE
+  {.id = TASK_EXECUTIVE_ID,          .name = "Executive",          .func = task_executive,        .step = NULL,                         .args = NULL, .priority = osPriorityAboveNormal, .stack_size = sizeof(executive_stack),        .stack_mem = executive_stack,        .period_ms = CONTROL_LOOP_PERIOD_MS,     .heartbeat_ms = 100,  .active = true},
+#endif
+#ifdef TASK_MOTOR_DRIVE
+  {.id = TASK_MOTOR_DRIVE_ID,        .name = "Motor Drive",        .func = task_motor_drive,      .step = NULL,                         .args = NULL, .priority = osPriorityAboveNormal, .stack_size = sizeof(motor_drive_stack),      .stack_mem = motor_drive_stack,      .period_ms = CONTROL_LOOP_PERIOD_MS,     .heartbeat_ms = 100,  .active = true},
+#endif
+#ifdef TASK_ARMING
+  {.id = TASK_ARMING_ID,             .name = "Arming",             .func = NULL,                  .step = task_arming_step,             .args = NULL, .priority = osPriorityNormal,      .stack_size = 0,                              .stack_mem = NULL,                   .period_ms = ARMING_PERIOD_MS,           .heartbeat_ms = 3000, .active = true},
+#endif
+#ifdef TASK_FAILSAFE
+  {.id = TASK_FAILSAFE_ID,           .name = "Failsafe",           .func = task_failsafe,         .step = NULL,                         .args = NULL, .priority = osPriorityAboveNormal, .stack_size = sizeof(failsafe_stack),         .stack_mem = failsafe_stack,         .period_ms = FAILSAFE_PERIOD_MS,         .heartbeat_ms = 100,  .active = true},
+#endif
+#if defined(TASK_CALC_ORIENTATION) && defined(DEVICE_BNO055)
+  {.id = TASK_CALC_ORIENTATION_ID,   .name = "Calc Orientation",   .func = task_calc_orientation, .step = NULL,                         .args = NULL, .priority = osPriorityNormal,      .stack_size = sizeof(calc_orientation_stack), .stack_mem = calc_orientation_stack, .period_ms = 10,                         .heartbeat_ms = 500,  .active = false},
+#endif
+#ifdef TASK_COLLECT_TELEMETRY
+  {.id = TASK_COLLECT_TELEMETRY_ID,  .name = "Collect Telemetry",  .func = NULL,                  .step = task_collect_telemetry_step,  .args = NULL, .priority = osPriorityNormal,      .stack_size = 0,                              .stack_mem = NULL,                   .period_ms = TELEMETRY_SAMPLE_PERIOD_MS, .heartbeat_ms = 0,    .active = true},
+#endif
+#if defined(TASK_STREAM_TELEMETRY) && defined(DEVICE_ESP8266)
+  {.id = TASK_STREAM_TELEMETRY_ID,   .name = "Stream Telemetry",   .func = task_stream_telemetry, .step = NULL,                         .args = NULL, .priority = osPriorityNormal,      .stack_size = sizeof(stream_telemetry_stack), .stack_mem = stream_telemetry_stack, .period_ms = TELEMETRY_STREAM_PERIOD_MS, .heartbeat_ms = 0,    .active = true},
+#endif
+#ifdef TASK_CALIBRATE_CHANNELS
+  {.id = TASK_CALIBRATE_CHANNELS_ID, .name = "Calibrate Channels", .func = NULL,                  .step = task_calibrate_channels_step, .args = NULL, .priority = osPriorityNormal,      .stack_size = 0,                              .stack_mem = NULL,                   .period_ms = CALIBRATION_TICK_MS,        .heartbeat_ms = 0,    .active = false},
+#endif
+#ifdef TASK_FLIGHT_LOG
+  {.id = TASK_FLIGHT_LOG_ID,         .name = "Flight Log",         .func = task_flight_log,       .step = NULL,                         .args = NULL, .priority = osPriorityLow,         .stack_size = sizeof(flight_log_stack),       .stack_mem = flight_log_stack,       .period_ms = 0,                          .heartbeat_ms = 0,    .active = true},
+#endif
+#ifdef TASK_STACK_MONITOR
+  {.id = TASK_STACK_MONITOR_ID,      .name = "Stack Monitor",      .func = task_stack_monitor,    .step = NULL,                         .args = NULL, .priority = osPriorityLow,         .stack_size = sizeof(stack_monitor_stack),    .stack_mem = stack_monitor_stack,    .period_ms = STACK_MONITOR_PERIOD_MS,    .heartbeat_ms = 0,    .active = true},
+#endif
+#ifdef TASK_SUPERVISOR
+  {.id = TASK_SUPERVISOR_ID,         .name = "Supervisor",         .func = task_supervisor,       .step = NULL,                         .args = NULL, .priority = osPriorityNormal,      .stack_size = sizeof(supervisor_stack),       .stack_mem = supervisor_stack,       .period_ms = SUPERVISOR_PERIOD_MS,       .heartbeat_ms = 0,    .active = true},
+#endif
+#ifdef TASK_LOG
+  {.id = TASK_LOG_ID,                .name = "Log",                .func = task_log,              .step = NULL,                         .args = NULL, .priority = osPriorityLow,         .stack_size = sizeof(log_stack),              .stack_mem = log_stack,              .period_ms = 0,                          .heartbeat_ms = 0,    .active = true},
+#endif
+#ifdef TASK_DEBUG
+  {.id = TASK_DEBUG_ID,              .name = "Debug",              .func = task_debug,            .step = NULL,                         .args = NULL, .priority = osPriorityNormal,      .stack_size = sizeof(debug_stack),            .stack_mem = debug_stack,            .period_ms = 1000,                       .heartbeat_ms = 0,    .active = true}
+#endif
+};
+
+#ifdef TASK_LOG
+/* Every task logs as it starts, before the low priority log writer runs */
+typedef char log_debug_queue_fits_boot[(LOG_DEBUG_QUEUE_LEN >= NUM_TASKS) ? 1 : -1];
+#endif
 
 void task_start(thread_args_t *targs, unsigned task_id) {
-  targs->serial->printf("started task %d (%s)\tstack [alloc: %d, used: %d, free: %d]\r\n", task_id, tasks[task_id].name, targs->threads[task_id].stack_size(), targs->threads[task_id].used_stack(), targs->threads[task_id].free_stack());
+  LOG_INFO("started task %d (%s)\tstack [alloc: %lu, used: %lu, free: %lu]\r\n", task_id, tasks[task_id].name,
+    (unsigned long) targs->threads[task_id].stack_size(),
+    (unsigned long) targs->threads[task_id].used_stack(),
+    (unsigned long) targs->threads[task_id].free_stack());
 
   // targs->serial->printf("Using %d bytes of stack.\r\n", task_id, tasks[task_id].name);
 }
 
+/**
+* @brief Execute a queued command and reply to the link it came from.
+* @note Commands arriving while the task is inactive are refused rather than
+*       left to pile up in the queue.
+*/
+#if defined(TASK_PROCESS_COMMANDS) || defined(TASK_SAFETY_COMMANDS)
+static void run_queued_command(thread_args_t *args, unsigned task_id, command_t *command) {
+  uint32_t start = task_iteration_begin(&args->tasks[task_id]);
+  int err = RET_NOT_ALLOWED;
+  if (args->tasks[task_id].active) {
+    err = command_execute(command, args);
+  }
+  command_respond(command, err, args);
+  task_iteration_end(&args->tasks[task_id], start);
+}
+#endif
+
 /**
 * @brief Execute commands as they become available on the mail queue.
+* @note Runs below the control loop, so slow commands never delay the ESCs.
 * @param [in/out] targs Thread arguments.
 */
 #ifdef TASK_PROCESS_COMMANDS
@@ -52,25 +189,43 @@ void task_process_commands(const void *targs) {
   thread_args_t * args = (thread_args_t *) targs;
   task_start(args, TASK_PROCESS_COMMANDS_ID);
   while (args->active) {
-    if (args->tasks[TASK_PROCESS_COMMANDS_ID].active) {
-      osEvent evt;
-      while ((evt = args->command_queue->get(1)).status == osEventMail) {
-          command_t *command_q = (command_t*) evt.value.p;
-          int err;
-          if ((err = command_execute(command_q, args)) != RET_OK) {
-            LOG("\rError: %s\r\n", err_to_str(err));
-          } else {
-            LOG("\rCommand succesful\r\n");
-          }
-          args->command_queue->free(command_q);
-      }
+    // Sleep until a command arrives
+    osEvent evt = args->command_queue->get();
+    if (evt.status != osEventMail) {
+      continue;
+    }
+    command_t *command_q = (command_t*) evt.value.p;
+    run_queued_command(args, TASK_PROCESS_COMMANDS_ID, command_q);
+    args->command_queue->free(command_q);
+  }
+}
+#endif
+
+/**
+* @brief Execute safety commands (e.g. disarm) as soon as they arrive.
+* @note Runs above the control loop, so is never stuck behind normal commands.
+* @param [in/out] targs Thread arguments.
+*/
+#ifdef TASK_SAFETY_COMMANDS
+void task_safety_commands(const void *targs) {
+  thread_args_t * args = (thread_args_t *) targs;
+  task_start(args, TASK_SAFETY_COMMANDS_ID);
+  while (args->active) {
+    osEvent evt = args->safety_command_queue->get();
+    if (evt.status != osEventMail) {
+      continue;
     }
+    command_t *command_q = (command_t*) evt.value.p;
+    run_queued_command(args, TASK_SAFETY_COMMANDS_ID, command_q);
+    args->safety_command_queue->free(command_q);
   }
 }
 #endif
 
 /**
 * @brief Creates primative commmand line interface on serial port.
+* @note Characters are received, edited and echoed by an interrupt, this task
+*       only wakes when a whole line has been entered.
 * @param [in/out] targs Thread arguments.
 */
 #ifdef TASK_READ_SERIAL
@@ -78,113 +233,145 @@ void task_read_serial(const void *targs){
   thread_args_t * args = (thread_args_t *) targs;
   task_start(args, TASK_READ_SERIAL_ID);
 
-  char buffer[100];
-  int pos = 0;
-  LOG( "$");
-  bool readable;
+  char buffer[CLI_LINE_LENGTH];
+  cli_init(args->serial);
+
   while (args->active) {
-    if (args->tasks[TASK_READ_SERIAL_ID].active) {
-      bool readable = args->serial->readable();
-      // LOG("test\r\n");
-      if (readable) {
-        buffer[pos] = args->serial->getc();
-
-        // If ENTER key is pressed, execute command
-        if (buffer[pos] == '\r') {
-          buffer[pos+1] = NULL;
-          LOG("\r\n");
-          command_t command;
-          // Generate a command structure for the command given
-          if (!command_generate(&command, buffer)) {
-            LOG("\rCommand not recognised!\r\n");
-          } else {
-            command_t *command_q = args->command_queue->alloc();
-            memcpy(command_q, &command, sizeof(command_t));
-            args->command_queue->put(command_q);
-          }
+    LOG("$ ");
+    if (cli_read_line(buffer, sizeof(buffer)) == 0) {
+      continue;
+    }
 
-          pos = -1;
-        }
-        //TODO: This function needs looking at.
-        if(pos > 0 ) {
-          if (buffer[pos] == '\b') {
-            buffer[pos] = NULL;
-            pos--;
-          }
-        }
-        buffer[pos+1] = NULL;
-        LOG("\r$ %s", buffer);
-        pos++;
-      }
+    if (!args->tasks[TASK_READ_SERIAL_ID].active) {
+      continue;
+    }
+
+    uint32_t start = task_iteration_begin(&args->tasks[TASK_READ_SERIAL_ID]);
+    command_t command;
+    memset(&command, 0x00, sizeof(command_t));
+    command.link = LINK_USB;
+    command.seq = 0;
+    command.tele_param = NULL;
+    // Generate a command structure for the command given
+    if (!command_generate(&command, buffer)) {
+      LOG("\rCommand not recognised!\r\n");
+    } else if (command_submit(args, &command) != RET_OK) {
+      LOG("\rCommand queue full!\r\n");
     }
+    task_iteration_end(&args->tasks[TASK_READ_SERIAL_ID], start);
   }
 }
 #endif
 
 
+#ifdef TASK_EVENTS
+static EventQueue task_event_queue(TASK_EVENT_QUEUE_LEN * EVENTS_EVENT_SIZE);
+
+/* Queue ID of each scheduled task's periodic event, 0 if not scheduled.
+   Only used on the events thread. */
+static int task_event_ids[NUM_TASKS];
+
 /**
-* @brief Set mbed LED0 --> LED3 to represent the arming state.
-* @param [in/out] targs Thread arguments.
+* @brief Run one iteration of a queued task, as its thread would have.
 */
-#ifdef TASK_LED_STATE
-void task_state_leds(const void *targs){
-  thread_args_t * args = (thread_args_t *) targs;
-  task_start(args, TASK_LED_STATE_ID);
+static void task_event_run(unsigned id) {
+  thread_args_t *args = (thread_args_t *) tasks[id].args;
+  task_t *task = &args->tasks[id];
+  task_t *events = &args->tasks[TASK_EVENTS_ID];
+
+  // The events task's own statistics cover every dispatch
+  uint32_t events_start = task_iteration_begin(events);
+
+  if (!task->active) {
+    // Stopped, or finished by itself, "task start" schedules it again
+    task_event_queue.cancel(task_event_ids[id]);
+    task_event_ids[id] = 0;
+  } else {
+    // Periodic events are due on a grid, so a late one is released when it was due
+    uint32_t now_us = us_ticker_read();
+    uint32_t period_us = task->period_ms * 1000;
+    uint32_t due_us = task->stats.release_us + period_us;
+    if (task->stats.has_run && now_us - due_us < period_us) {
+      task_release(task, due_us);
+    }
 
-  static state_t previous_state = args->state;
-  bool first_time = true;
-  bool weapon_only_ripple[4] = {true, false, false, false};
-  bool tmp_ripple;
+    uint32_t start = task_iteration_begin(task);
+    task->step(args);
+    task_iteration_end(task, start);
+  }
 
-  while (args->active) {
-    if (args->tasks[TASK_LED_STATE_ID].active) {
-      if (args->state != previous_state || first_time) {
-        LOG("state change: %s --> %s\r\n", state_to_str(previous_state), state_to_str(args->state));
-        switch (args->state) {
-          case STATE_DISARMED:
-            args->leds[0]->write(false);
-            args->leds[1]->write(false);
-            args->leds[2]->write(false);
-            args->leds[3]->write(false);
-            break;
-          case STATE_DRIVE_ONLY:
-            args->leds[0]->write(true);
-            args->leds[1]->write(true);
-            args->leds[2]->write(false);
-            args->leds[3]->write(false);
-            break;
-          case STATE_WEAPON_ONLY:
-            break;
-          case STATE_FULLY_ARMED:
-            args->leds[0]->write(true);
-            args->leds[1]->write(true);
-            args->leds[2]->write(true);
-            args->leds[3]->write(true);
-            break;
-        }
-      }
+  task_iteration_end(events, events_start);
+}
 
-      /* The weapon only state is a special case where fancy LED strobing is used
-         We need to do this outside the above switch statement, as we require a
-         LED change every loop, rather than just on a state change.
-      */
-      if (args->state == STATE_WEAPON_ONLY) {
-        args->leds[0]->write(weapon_only_ripple[0]);
-        args->leds[1]->write(weapon_only_ripple[1]);
-        args->leds[2]->write(weapon_only_ripple[2]);
-        args->leds[3]->write(weapon_only_ripple[3]);
-
-        // Move LED along by one
-        tmp_ripple = weapon_only_ripple[3];
-        memmove(&weapon_only_ripple[1], &weapon_only_ripple[0], sizeof(bool)*3);
-        weapon_only_ripple[0] = tmp_ripple;
-      }
+/**
+* @brief Schedule a queued task at its current period, on the events thread.
+*/
+static void task_events_start(unsigned id) {
+  if (task_event_ids[id] != 0) {
+    task_event_queue.cancel(task_event_ids[id]);
+  }
+  task_event_ids[id] = task_event_queue.call_every(tasks[id].period_ms, task_event_run, id);
+}
+
+void task_events_schedule(unsigned id) {
+  task_event_queue.call(task_events_start, id);
+}
+
+/**
+* @brief Run the low rate tasks as callbacks on one event queue.
+* @details Tasks with a step function have no thread of their own. Each one
+*          is called every period_ms from this thread while it is active,
+*          which saves a stack and a context switch per iteration for tasks
+*          that would otherwise spend nearly all of their time asleep.
+* @param [in/out] targs Thread arguments.
+*/
+void task_events(const void *targs) {
+  thread_args_t * args = (thread_args_t *) targs;
+  task_start(args, TASK_EVENTS_ID);
 
-      previous_state = args->state;
-      first_time = false;
-      Thread::wait(100);
+  unsigned t;
+  for (t = 0; t < NUM_TASKS; t++) {
+    if (args->tasks[t].step != NULL && args->tasks[t].active) {
+      task_events_start(t);
     }
   }
+
+  task_event_queue.dispatch_forever();
+}
+#endif
+
+#if defined(TASK_MOTOR_DRIVE) || defined(TASK_EXECUTIVE)
+/**
+* @brief One iteration of task_motor_drive(), from receiver input to ESC output.
+* @param [in/out] targs Thread arguments.
+*/
+void task_motor_drive_step(const void *targs) {
+  thread_args_t * args = (thread_args_t *) targs;
+  // Use the same settings for the whole iteration
+  settings_t settings;
+  settings_read(&settings);
+  args->drive_mode = (drive_mode_t*) &drive_modes[settings.drive_mode];
+  args->weapon_mode = (weapon_mode_t*) &weapon_modes[settings.weapon_mode];
+
+  // Read pusle width from receiver
+  read_recv_pw(args, &settings);
+
+  // Calculate drive motor output pulse widths
+  args->drive_mode->drive(args);
+
+  // Calculate weapon motor output pulse widths
+  args->weapon_mode->weapon(args);
+
+  // Set PWM outputs to ESCs
+  set_output_escs(args);
+
+  // Keep what we need to resume quickly after a watchdog reset
+  warm_start_save_control(args);
+
+#ifdef TASK_FLIGHT_LOG
+  // Snapshot controls and outputs into the flight log buffer
+  log_flight_record(args);
+#endif
 }
 #endif
 
@@ -201,105 +388,104 @@ void task_motor_drive(const void *targs) {
 
   while (args->active) {
     if (args->tasks[TASK_MOTOR_DRIVE_ID].active) {
-      // Read pusle width from receiver
-      read_recv_pw(args);
-
-      // Calculate drive motor output pulse widths
-      args->drive_mode->drive(args);
-
-      // Calculate weapon motor output pulse widths
-      args->weapon_mode->weapon(args);
-
-      // Set PWM outputs to ESCs
-      set_output_escs(args);
+      uint32_t start = task_iteration_begin(&args->tasks[TASK_MOTOR_DRIVE_ID]);
+      task_motor_drive_step(args);
+      task_iteration_end(&args->tasks[TASK_MOTOR_DRIVE_ID], start);
     }
+#ifndef TASK_SUPERVISOR
     // Kick watchdog
     args->wdt->kick();
+#endif
+    task_sleep(&args->tasks[TASK_MOTOR_DRIVE_ID]);
   }
 }
 #endif
 
+#if defined(TASK_ARMING) || defined(TASK_EXECUTIVE)
 /**
-* @brief Change the arming state based on the arming switch.
+* @brief One iteration of task_arming().
 * @param [in/out] targs Thread arguments.
 */
-#ifdef TASK_ARMING
-void task_arming(const void *targs) {
+void task_arming_step(const void *targs) {
   thread_args_t * args = (thread_args_t *) targs;
-  task_start(args, TASK_ARMING_ID);
-
   bool drive_switch, weapon_switch, drive_arm, weapon_arm, drive_stalled, weapon_stalled;
-
-  while (args->active) {
-    if (args->tasks[TASK_ARMING_ID].active) {
-      args->mutex.controls->lock();
-      weapon_switch = (args->controls[0].channel[RC_0_ARM_SWITCH] > RC_SWITCH_MIDPOINT);
-      drive_switch = (args->controls[1].channel[RC_1_ARM_SWITCH] > RC_SWITCH_MIDPOINT);
-      args->mutex.controls->unlock();
-
-      /* If a transmitter is lost (turned off/out of range),
-         disable arming for that TX.
-      */
-      drive_stalled = is_drive_stalled(args);
-      weapon_stalled = is_weapon_stalled(args);
-
-      args->mutex.controls->lock();
-      weapon_arm = weapon_switch && !weapon_stalled &&
-        BETWEEN(args->controls[0].channel[RC_0_THROTTLE], 0, 2) &&
-        BETWEEN(args->controls[0].channel[RC_0_ELEVATION], 45, 55) &&
-        BETWEEN(args->controls[0].channel[RC_0_RUDDER], 45, 55) &&
-        BETWEEN(args->controls[0].channel[RC_0_AILERON], 45, 55);
-      args->mutex.controls->unlock();
-
-      args->mutex.controls->lock();
-      drive_arm = drive_switch && !drive_stalled &&
-        BETWEEN(args->controls[1].channel[RC_1_THROTTLE], 0, 2) &&
-        BETWEEN(args->controls[1].channel[RC_1_ELEVATION], 45, 55) &&
-        BETWEEN(args->controls[1].channel[RC_1_RUDDER], 45, 55) &&
-        BETWEEN(args->controls[1].channel[RC_1_AILERON], 45, 55);
-      args->mutex.controls->unlock();
-
-      //Debug: Print RX values
-      // args->serial->printf("drive_switch : %.0f (%s)\r\n", args->controls[0].channel[RC_0_ARM_SWITCH], drive_switch ? "On" : "Off");
-      // args->serial->printf("weapon_switch: %.0f (%s)\r\n", args->controls[1].channel[RC_1_ARM_SWITCH], weapon_switch ? "On" : "Off");
-
-      switch (args->state) {
-        /* From the fully armed state we can only decrease the arm state,
-        so we don't need to be concerned with the stick positions. */
-        case STATE_FULLY_ARMED:
-          if (!drive_switch && !weapon_switch) {
-            args->state = STATE_DISARMED;
-          } else if (drive_switch && !weapon_switch) {
-            args->state = STATE_DRIVE_ONLY;
-          } else if (!drive_switch && weapon_switch) {
-            args->state = STATE_WEAPON_ONLY;
-          }
-          break;
-        case STATE_DRIVE_ONLY:
-          if (!drive_switch) {
-            args->state = STATE_DISARMED;
-          } else if (weapon_arm) {
-            args->state = STATE_FULLY_ARMED;
-          }
-          break;
-        case STATE_WEAPON_ONLY:
-          if (!weapon_switch) {
-            args->state = STATE_DISARMED;
-          } else if (drive_arm) {
-            args->state = STATE_FULLY_ARMED;
-          }
-          break;
-        case STATE_DISARMED:
-          if (drive_arm && weapon_arm) {
-            args->state = STATE_FULLY_ARMED;
-          } else if (drive_arm) {
-            args->state = STATE_DRIVE_ONLY;
-          } else if (weapon_arm) {
-            args->state = STATE_WEAPON_ONLY;
-          }
-      }
+  settings_t s;
+
+  settings_read(&s);
+
+  args->mutex.controls->lock();
+  weapon_switch = (args->controls[0].channel[RC_0_ARM_SWITCH] > s.switch_midpoint);
+  drive_switch = (args->controls[1].channel[RC_1_ARM_SWITCH] > s.switch_midpoint);
+  args->mutex.controls->unlock();
+
+  /* If a transmitter is lost (turned off/out of range),
+     disable arming for that TX.
+  */
+  drive_stalled = is_drive_stalled(args, s.stall_timeout_ms);
+  weapon_stalled = is_weapon_stalled(args, s.stall_timeout_ms);
+
+  args->mutex.controls->lock();
+  weapon_arm = weapon_switch && !weapon_stalled &&
+    BETWEEN(args->controls[0].channel[RC_0_THROTTLE], 0, s.throttle_arm_max) &&
+    BETWEEN(args->controls[0].channel[RC_0_ELEVATION], s.stick_centre_min, s.stick_centre_max) &&
+    BETWEEN(args->controls[0].channel[RC_0_RUDDER], s.stick_centre_min, s.stick_centre_max) &&
+    BETWEEN(args->controls[0].channel[RC_0_AILERON], s.stick_centre_min, s.stick_centre_max);
+  args->mutex.controls->unlock();
+
+  args->mutex.controls->lock();
+  drive_arm = drive_switch && !drive_stalled &&
+    BETWEEN(args->controls[1].channel[RC_1_THROTTLE], 0, s.throttle_arm_max) &&
+    BETWEEN(args->controls[1].channel[RC_1_ELEVATION], s.stick_centre_min, s.stick_centre_max) &&
+    BETWEEN(args->controls[1].channel[RC_1_RUDDER], s.stick_centre_min, s.stick_centre_max) &&
+    BETWEEN(args->controls[1].channel[RC_1_AILERON], s.stick_centre_min, s.stick_centre_max);
+  args->mutex.controls->unlock();
+
+  //Debug: Print RX values
+  // args->serial->printf("drive_switch : %.0f (%s)\r\n", args->controls[0].channel[RC_0_ARM_SWITCH], drive_switch ? "On" : "Off");
+  // args->serial->printf("weapon_switch: %.0f (%s)\r\n", args->controls[1].channel[RC_1_ARM_SWITCH], weapon_switch ? "On" : "Off");
+
+  /* A switch turned off always lowers the arm state. Only when neither has
+  may the state be raised, so one iteration never both drops and re-arms. */
+  bool dropped = false;
+  if (!drive_switch) {
+    dropped |= state_raise(&args->state, STATE_EVENT_DRIVE_SWITCH_OFF);
+  }
+  if (!weapon_switch) {
+    dropped |= state_raise(&args->state, STATE_EVENT_WEAPON_SWITCH_OFF);
+  }
+  if (!dropped) {
+    if (drive_arm) {
+      state_raise(&args->state, STATE_EVENT_DRIVE_READY);
     }
-    Thread::wait(1000);
+    if (weapon_arm) {
+      state_raise(&args->state, STATE_EVENT_WEAPON_READY);
+    }
+  }
+}
+#endif
+
+#if defined(TASK_FAILSAFE) || defined(TASK_EXECUTIVE)
+/**
+* @brief Drop the arming state for any transmitter that has stopped sending.
+* @param [in/out] targs Thread arguments.
+*/
+void task_failsafe_step(const void *targs) {
+  thread_args_t * args = (thread_args_t *) targs;
+  bool drive_inactive, weapon_inactive;
+  settings_t s;
+
+  settings_read(&s);
+
+  // The cutoff interrupt has stopped the ESCs already, this catches up the state
+  esc_cutoff_set_timeout(s.stall_timeout_ms);
+  weapon_inactive = is_weapon_stalled(args, s.stall_timeout_ms);
+  drive_inactive = is_drive_stalled(args, s.stall_timeout_ms);
+
+  if (drive_inactive) {
+    state_raise(&args->state, STATE_EVENT_DRIVE_STALL);
+  }
+  if (weapon_inactive) {
+    state_raise(&args->state, STATE_EVENT_WEAPON_STALL);
   }
 }
 #endif
@@ -309,36 +495,11 @@ void task_failsafe(const void *targs) {
   thread_args_t * args = (thread_args_t *) targs;
   task_start(args, TASK_FAILSAFE_ID);
 
-  bool drive_inactive, weapon_inactive;
-
   while (args->active) {
     if (args->tasks[TASK_FAILSAFE_ID].active) {
-      weapon_inactive = is_weapon_stalled(args);
-      drive_inactive = is_drive_stalled(args);
-
-      switch (args->state) {
-        case STATE_FULLY_ARMED:
-          if (drive_inactive && weapon_inactive) {
-            args->state = STATE_DISARMED;
-          } else if (drive_inactive && !weapon_inactive) {
-            args->state = STATE_WEAPON_ONLY;
-          } else if (!drive_inactive && weapon_inactive) {
-            args->state = STATE_DRIVE_ONLY;
-          }
-          break;
-        case STATE_DRIVE_ONLY:
-          if (drive_inactive) {
-            args->state = STATE_DISARMED;
-          }
-          break;
-        case STATE_WEAPON_ONLY:
-          if (weapon_inactive){
-            args->state = STATE_DISARMED;
-          }
-          break;
-        default:
-          break;
-      }
+      uint32_t start = task_iteration_begin(&args->tasks[TASK_FAILSAFE_ID]);
+      task_failsafe_step(args);
+      task_iteration_end(&args->tasks[TASK_FAILSAFE_ID], start);
     }
     // For debugging purposes
     // Thread::wait(1000);
@@ -354,10 +515,117 @@ void task_failsafe(const void *targs) {
     // args->serial->printf("weapon stall timer: %d ms\r\n", args->receiver[0].channel[3]->stallTimer.read_ms());
     // args->serial->printf("weapon stall timer: %d ms\r\n", args->receiver[0].channel[4]->stallTimer.read_ms());
     // args->serial->printf("weapon stall timer: %d ms\r\n", args->receiver[0].channel[5]->stallTimer.read_ms());
+    task_sleep(&args->tasks[TASK_FAILSAFE_ID]);
   }
 }
 #endif
 
+#ifdef TASK_EXECUTIVE
+/* Thread signal set by the frame timer */
+#define EXECUTIVE_FRAME_SIGNAL 0x1
+
+/**
+ * A step run by the executive every period_ms, in frames where
+ * frame % (period_ms / CONTROL_LOOP_PERIOD_MS) == offset.
+ */
+typedef struct {
+  void (*step)(const void *targs);
+  uint32_t period_ms;
+  uint32_t offset;
+  bool active;
+} executive_slot_t;
+
+/* The control loop runs first in every frame. The offsets keep the other
+   slots out of each other's frames (failsafe on odd frames, the rest on
+   distinct even ones), so a frame never runs more than two slots. Periods
+   must be multiples of CONTROL_LOOP_PERIOD_MS. */
+static executive_slot_t executive_slots[] = {
+  {task_motor_drive_step,       CONTROL_LOOP_PERIOD_MS,     0, true},
+  {task_failsafe_step,          FAILSAFE_PERIOD_MS,         1, true},
+  {task_collect_telemetry_step, TELEMETRY_SAMPLE_PERIOD_MS, 2, true},
+  {task_arming_step,            ARMING_PERIOD_MS,           6, true},
+};
+
+static const unsigned NUM_EXECUTIVE_SLOTS = sizeof(executive_slots) / sizeof(executive_slots[0]);
+
+static Ticker executive_timer;
+static Thread *executive_thread = NULL;
+/* Written by the frame timer only */
+static volatile uint32_t executive_frames_released = 0;
+static volatile uint32_t executive_release_us = 0;
+
+/**
+* @brief Frame timer interrupt, releases the next frame.
+*/
+static void executive_tick(void) {
+  executive_release_us = us_ticker_read();
+  executive_frames_released++;
+  executive_thread->signal_set(EXECUTIVE_FRAME_SIGNAL);
+}
+
+void task_executive_disable(void (*step)(const void *targs)) {
+  unsigned s;
+  for (s = 0; s < NUM_EXECUTIVE_SLOTS; s++) {
+    if (executive_slots[s].step == step) {
+      executive_slots[s].active = false;
+    }
+  }
+}
+
+/**
+* @brief Run the control loop, failsafe, arming, LEDs and telemetry sampling
+*        as a time-triggered cyclic executive.
+* @details A timer interrupt releases a frame every CONTROL_LOOP_PERIOD_MS,
+*          and each frame runs the slots that are due in it, in table order.
+*          The slots take mutexes, so they run in this thread rather than in
+*          the interrupt itself. A frame that starts late (overran by the
+*          previous one) is counted as a deadline miss, and is still run so
+*          that no slot loses a release.
+* @param [in/out] targs Thread arguments.
+*/
+void task_executive(const void *targs) {
+  thread_args_t * args = (thread_args_t *) targs;
+  task_start(args, TASK_EXECUTIVE_ID);
+
+  task_t *task = &args->tasks[TASK_EXECUTIVE_ID];
+  uint32_t frame_us = CONTROL_LOOP_PERIOD_MS * 1000;
+  uint32_t frame = 0;
+  unsigned s;
+
+  executive_thread = &args->threads[TASK_EXECUTIVE_ID];
+  executive_timer.attach_us(callback(executive_tick), frame_us);
+
+  while (args->active) {
+    Thread::signal_wait(EXECUTIVE_FRAME_SIGNAL);
+
+    core_util_critical_section_enter();
+    uint32_t released = executive_frames_released;
+    uint32_t release_us = executive_release_us;
+    core_util_critical_section_exit();
+
+    // Catch up on every frame released since the last wait
+    while (frame != released) {
+      task_release(task, release_us - (released - frame - 1) * frame_us);
+
+      uint32_t start = task_iteration_begin(task);
+      for (s = 0; s < NUM_EXECUTIVE_SLOTS; s++) {
+        const executive_slot_t *slot = &executive_slots[s];
+        if (slot->active && frame % (slot->period_ms / CONTROL_LOOP_PERIOD_MS) == slot->offset) {
+          slot->step(args);
+        }
+      }
+      task_iteration_end(task, start);
+      frame++;
+
+#ifndef TASK_SUPERVISOR
+      // Kick watchdog
+      args->wdt->kick();
+#endif
+    }
+  }
+  executive_timer.detach();
+}
+#endif
 
 #if defined (TASK_CALC_ORIENTATION) && defined(DEVICE_BNO055)
 void task_calc_orientation(const void *targs) {
@@ -366,10 +634,12 @@ void task_calc_orientation(const void *targs) {
 
   while (args->active) {
     if (args->tasks[TASK_CALC_ORIENTATION_ID].active) {
+      uint32_t start = task_iteration_begin(&args->tasks[TASK_CALC_ORIENTATION_ID]);
+
       /* If there is an error then we maintain the same
        * orientation to stop random control flipping */
       if (!bno055_healthy()) {
-          LOG("ERROR: BNO055 has an error/status problem!!!\r\n");
+          LOG_ERROR("ERROR: BNO055 has an error/status problem!!!\r\n");
       } else {
           /* Read in the Euler angles */
           args->orientation = bno055_read_euler_angles();
@@ -382,119 +652,42 @@ void task_calc_orientation(const void *targs) {
               args->inverted = false;
           }
           #if defined (PC_DEBUGGING) && defined (DEBUG_ORIENTATION)
-          args->serial->printf("Inverted= %s \t (%7.2f) \r\n", args->inverted ? "true" : "false", orientation.roll);
+          LOG_DEBUG("Inverted= %s \t (%7.2f) \r\n", args->inverted ? "true" : "false", orientation.roll);
           #endif
       }
+      task_iteration_end(&args->tasks[TASK_CALC_ORIENTATION_ID], start);
     }
+    task_sleep(&args->tasks[TASK_CALC_ORIENTATION_ID]);
   }
 }
 #endif
 
-#ifdef TASK_COLLECT_TELEMETRY
-void task_collect_telemetry(const void *targs) {
+#if defined(TASK_COLLECT_TELEMETRY) || defined(TASK_EXECUTIVE)
+/**
+* @brief Sample every telemetry parameter that has a getter.
+* @param [in/out] targs Thread arguments.
+*/
+void task_collect_telemetry_step(const void *targs) {
   thread_args_t * args = (thread_args_t *) targs;
-  task_start(args, TASK_COLLECT_TELEMETRY_ID);
-
-  uint32_t tmp_int;
-  euler_t e;
+  tele_value_t value;
   unsigned i;
-  while (args->active) {
-    if (args->tasks[TASK_COLLECT_TELEMETRY_ID].active) {
-      for (i = 0; i < NUM_TELE_COMMANDS; i++) {
-        switch (tele_commands[i].id) {
-          case CID_DRIVE_RPM_1:
-            // TODO(camieac): Add support for RPM sensing
-            args->mutex.telemetry->lock();
-            tele_commands[i].param.f = 0.00f;
-            args->mutex.telemetry->unlock();
-            break;
-          case CID_DRIVE_RPM_2:
-            // TODO(camieac): Add support for RPM sensing
-            args->mutex.telemetry->lock();
-            tele_commands[i].param.f = 0.00f;
-            args->mutex.telemetry->unlock();
-            break;
-          case CID_DRIVE_RPM_3:
-            // TODO(camieac): Add support for RPM sensing
-            args->mutex.telemetry->lock();
-            tele_commands[i].param.f = 0.00f;
-            args->mutex.telemetry->unlock();
-            break;
-          case CID_WEAPON_RPM_1:
-            // TODO(camieac): Add support for RPM sensing
-            args->mutex.telemetry->lock();
-            tele_commands[i].param.f = 0.00f;
-            args->mutex.telemetry->unlock();
-            break;
-          case CID_WEAPON_RPM_2:
-            // TODO(camieac): Add support for RPM sensing
-            args->mutex.telemetry->lock();
-            tele_commands[i].param.f = 0.00f;
-            args->mutex.telemetry->unlock();
-            break;
-          case CID_WEAPON_RPM_3:
-            // TODO(camieac): Add support for RPM sensing
-            args->mutex.telemetry->lock();
-            tele_commands[i].param.f = 0.00f;
-            args->mutex.telemetry->unlock();
-            break;
-#ifdef DEVICE_BNO055
-          /* Accelerations are captured in one function */
-          case CID_ACCEL_X:
-          case CID_ACCEL_Y:
-          case CID_ACCEL_Z:
-            e = bno055_read_accel();
-            args->mutex.telemetry->lock();
-            tele_commands[CID_ACCEL_X].param.f = e.x;
-            tele_commands[CID_ACCEL_Y].param.f = e.y;
-            tele_commands[CID_ACCEL_Z].param.f = e.z;
-            args->mutex.telemetry->unlock();
-            // We do x, y and z in one op, so skip 2 once done
-            if (i == CID_ACCEL_X) {
-              i+=2;
-            }
-            break;
 
-          /* Pitch, roll and yaw are captured in one function. */
-          case CID_PITCH:
-          case CID_ROLL:
-          case CID_YAW:
-            e = bno055_read_euler_angles();
-            args->mutex.telemetry->lock();
-            tele_commands[CID_PITCH].param.f = e.pitch;
-            tele_commands[CID_ROLL].param.f = e.roll;
-            tele_commands[CID_YAW].param.f = e.heading;
-            args->mutex.telemetry->unlock();
-            // We do x, y and z in one op, so skip 2 once done
-            if (i == CID_PITCH) {
-              i+=2;
-            }
-            break;
-          case CID_AMBIENT_TEMP:
-            args->mutex.telemetry->lock();
-            tmp_int = bno055_read_temp();
-            args->mutex.telemetry->unlock();
-            tele_commands[i].param.i = tmp_int;
-            break;
-#endif
-          case CID_WEAPON_VOLTAGE_1:
-          case CID_WEAPON_VOLTAGE_2:
-          case CID_WEAPON_VOLTAGE_3:
-          case CID_DRIVE_VOLTAGE_1:
-          case CID_DRIVE_VOLTAGE_2:
-          case CID_DRIVE_VOLTAGE_3:
-            break;
-          case CID_ARM_STATUS:
-            args->mutex.telemetry->lock();
-            tele_commands[i].param.i = args->state;
-            args->mutex.telemetry->unlock();
-            break;
-          default:
-            args->serial->puts("UNSUPPORTED TELE COMMAND\r\n");
-        }
-      }
-      wait(1);
+  // One read of each sensor for the whole sample
+  tele_params_sample(args);
+
+  for (i = 0; i < NUM_TELE_COMMANDS; i++) {
+    if (tele_commands[i].get == NULL) {
+      continue;
     }
+    tele_commands[i].get(args, &value);
+
+    args->mutex.telemetry->lock();
+    tele_commands[i].param = value;
+    if (tele_commands[i].aggregate) {
+      tele_aggregate_add(&tele_commands[i].window,
+        tele_commands[i].type == CT_FLOAT ? value.f : (float) value.i);
+    }
+    args->mutex.telemetry->unlock();
   }
 }
 #endif
@@ -505,77 +698,93 @@ void task_stream_telemetry(const void *targs) {
   task_start(args, TASK_STREAM_TELEMETRY_ID);
 
   /* Temp values */
-  float tmp_f;
-  uint32_t tmp_i;
-  bool tmp_b;
+  tele_value_t tmp;
+  tele_aggregate_t window;
 
   unsigned i = 0;
   while (args->active) {
     /* The ESP looks for a carriage return character to delimit a command. */
     if (args->tasks[TASK_STREAM_TELEMETRY_ID].active) {
+      uint32_t start = task_iteration_begin(&args->tasks[TASK_STREAM_TELEMETRY_ID]);
       for (i = 0; i < NUM_TELE_COMMANDS; i++) {
-        switch (tele_commands[i].type) {
-          case CT_FLOAT:
-            args->mutex.telemetry->lock();
-            tmp_f = tele_commands[i].param.f;
-            args->mutex.telemetry->unlock();
-
-            args->esp_serial->printf(
-              "{\"id\": \"%d\", \"name\": \"%s\", \"type\": \"%s\", \"unit\": \"%s\", \"value\": \"%.2f\"}\r",
-              tele_commands[i].id,
-              tele_commands[i].name,
-              tele_command_type_to_string(tele_commands[i].type),
-              tele_command_unit_to_string(tele_commands[i].unit),
-              tmp_f);
-          break;
-          case CT_INT:
-            args->mutex.telemetry->lock();
-            tmp_i = tele_commands[i].param.i;
-            args->mutex.telemetry->unlock();
-
-            args->esp_serial->printf(
-              "{\"id\": \"%d\", \"name\": \"%s\", \"type\": \"%s\", \"unit\": \"%s\", \"value\": \"%d\"}\r",
-              tele_commands[i].id,
-              tele_commands[i].name,
-              tele_command_type_to_string(tele_commands[i].type),
-              tele_command_unit_to_string(tele_commands[i].unit),
-              tmp_i);
-            break;
-          case CT_BOOLEAN:
-            args->mutex.telemetry->lock();
-            tmp_b = tele_commands[i].param.b;
-            args->mutex.telemetry->unlock();
-
-            args->esp_serial->printf(
-              "{\"id\": \"%d\", \"name\": \"%s\", \"type\": \"%s\", \"unit\": \"%s\", \"value\": \"%s\"}\r",
-              tele_commands[i].id,
-              tele_commands[i].name,
-              tele_command_type_to_string(tele_commands[i].type),
-              tele_command_unit_to_string(tele_commands[i].unit),
-              tmp_b ? "ON" : "OFF");
-            break;
-          case CT_NONE:
-          default:
-            args->serial->printf("Type not yet supported for streaming.\r\n");
+        /* Take the latest value and the window collected since the
+           last stream, then start a new window. */
+        args->mutex.telemetry->lock();
+        tmp = tele_commands[i].param;
+        window = tele_commands[i].window;
+        tele_aggregate_reset(&tele_commands[i].window);
+        args->mutex.telemetry->unlock();
+
+        /* Each parameter is written as a whole line, so that command
+           responses on the same link aren't interleaved with it. */
+        args->mutex.esp_serial->lock();
+        if (tele_commands[i].aggregate && window.count > 0) {
+          /* Report the window rather than a single point, so that short
+             events (e.g. current spikes) still show up. */
+          args->esp_serial->printf(
+            "{\"id\": \"%d\", \"name\": \"%s\", \"type\": \"%s\", \"unit\": \"%s\", \"value\": \"%.2f\", "
+            "\"min\": \"%.2f\", \"max\": \"%.2f\", \"count\": \"%d\"}\r",
+            tele_commands[i].id,
+            tele_commands[i].name,
+            tele_command_type_to_string(tele_commands[i].type),
+            tele_command_unit_to_string(tele_commands[i].unit),
+            tele_aggregate_mean(&window),
+            window.min,
+            window.max,
+            window.count);
+        } else {
+          switch (tele_commands[i].type) {
+            case CT_FLOAT:
+              args->esp_serial->printf(
+                "{\"id\": \"%d\", \"name\": \"%s\", \"type\": \"%s\", \"unit\": \"%s\", \"value\": \"%.2f\"}\r",
+                tele_commands[i].id,
+                tele_commands[i].name,
+                tele_command_type_to_string(tele_commands[i].type),
+                tele_command_unit_to_string(tele_commands[i].unit),
+                tmp.f);
             break;
+            case CT_INT:
+              args->esp_serial->printf(
+                "{\"id\": \"%d\", \"name\": \"%s\", \"type\": \"%s\", \"unit\": \"%s\", \"value\": \"%d\"}\r",
+                tele_commands[i].id,
+                tele_commands[i].name,
+                tele_command_type_to_string(tele_commands[i].type),
+                tele_command_unit_to_string(tele_commands[i].unit),
+                tmp.i);
+              break;
+            case CT_BOOLEAN:
+              args->esp_serial->printf(
+                "{\"id\": \"%d\", \"name\": \"%s\", \"type\": \"%s\", \"unit\": \"%s\", \"value\": \"%s\"}\r",
+                tele_commands[i].id,
+                tele_commands[i].name,
+                tele_command_type_to_string(tele_commands[i].type),
+                tele_command_unit_to_string(tele_commands[i].unit),
+                tmp.b ? "ON" : "OFF");
+              break;
+            case CT_NONE:
+            default:
+              LOG_WARN("Type not yet supported for streaming.\r\n");
+              break;
+          }
         }
+        args->mutex.esp_serial->unlock();
       }
-      wait(1);
+      task_iteration_end(&args->tasks[TASK_STREAM_TELEMETRY_ID], start);
     }
+    task_sleep(&args->tasks[TASK_STREAM_TELEMETRY_ID]);
   }
 }
 #endif
 
-
 void task_print_channels(const void *targs) {
   thread_args_t * args = (thread_args_t *) targs;
 
   while (args->active) {
     int controller, channel;
     for (controller = 0; controller < RC_NUMBER_CONTROLLERS; controller++) {
-      args->serial->printf("Controller %d\r\n", controller+1);
+      LOG_DEBUG("Controller %d\r\n", controller+1);
       for (channel = 0; channel < RC_NUMBER_CHANNELS; channel++) {
-        args->serial->printf("Channel %d: %d\r\n", channel+1, convert_pulsewidth(args->receiver[controller].channel[channel]->pulsewidth()));
+        LOG_DEBUG("Channel %d: %d\r\n", channel+1, convert_pulsewidth(args->receiver[controller].channel[channel]->pulsewidth()));
       }
     }
     Thread::wait(1000);
@@ -583,83 +792,264 @@ void task_print_channels(const void *targs) {
 }
 
 #ifdef TASK_CALIBRATE_CHANNELS
-void task_calibrate_channels(const void *targs) {
-  thread_args_t * args = (thread_args_t *) targs;
-  task_start(args, TASK_CALIBRATE_CHANNELS_ID);
+/**
+* @brief Record the extremes of every receiver channel for
+*        CALIBRATION_TIME_MS, then publish them as the channel limits.
+* @details Runs every CALIBRATION_TICK_MS while active, one sample per call,
+*          and deactivates itself when calibration is complete. Shares the
+*          events thread with arming, so prints with LOG_MESSAGE(), which
+*          drops a message rather than wait for room as LOG() does.
+* @param [in/out] targs Thread arguments.
+*/
+static volatile bool calibration_restart = false;
 
+void task_calibrate_channels_restart(void) {
+  // Only the step itself writes its countdown, as it runs on another thread
+  calibration_restart = true;
+}
+
+void task_calibrate_channels_step(const void *targs) {
+  thread_args_t * args = (thread_args_t *) targs;
+  static unsigned calibration_time = 0;
+  static channel_limits_t limits[RC_NUMBER_CONTROLLERS][RC_NUMBER_CHANNELS];
   int controller, channel;
-  unsigned calibration_time;
-  unsigned calibration_time_ms = 10000;
-  unsigned calibration_tick = 100;
   float tmp;
 
+  if (calibration_restart) {
+    calibration_restart = false;
+    calibration_time = 0;
+  }
+
+  if (calibration_time == 0) {
+    LOG_MESSAGE(LOG_CHANNEL_CONSOLE, "Controller calibration beginning,\r\n");
+    LOG_MESSAGE(LOG_CHANNEL_CONSOLE, "move controller sticks & switches to extremities.\r\n");
+    calibration_time = CALIBRATION_TIME_MS;
+
+    /* Set all limits to extremes. The limits in use are left alone until
+       calibration is complete, so the control loop is unaffected. */
+    for (controller = 0; controller < RC_NUMBER_CONTROLLERS; controller++) {
+      for (channel = 0; channel < RC_NUMBER_CHANNELS; channel++) {
+        limits[controller][channel].min = 10000.0f;
+        limits[controller][channel].max = -10000.0f;
+      }
+    }
+  }
+
+  if(calibration_time % 1000 == 0){
+    // Countdown
+    LOG_MESSAGE(LOG_CHANNEL_CONSOLE, "%.0f...", calibration_time / 1000.0f);
+  }
+
+  // Find min and max pulsewidths for each channel
+  for (controller = 0; controller < RC_NUMBER_CONTROLLERS; controller++) {
+    for (channel = 0; channel < RC_NUMBER_CHANNELS; channel++) {
+      tmp = args->receiver[controller].channel[channel]->pulsewidth();
+      // Find min
+      if (tmp < limits[controller][channel].min) {
+        limits[controller][channel].min = tmp;
+      }
+
+      // Find max
+      if (tmp > limits[controller][channel].max) {
+        limits[controller][channel].max = tmp;
+      }
+    }
+  }
+
+  calibration_time -= CALIBRATION_TICK_MS;
+  if (calibration_time > 0) {
+    return;
+  }
+
+  // End countdown
+  LOG_MESSAGE(LOG_CHANNEL_CONSOLE, "\r\n");
+
+  // Publish all the new limits in one go
+  settings_t *settings = settings_edit_begin();
+  memcpy(settings->channel_limits, limits, sizeof(limits));
+  int ret = settings_edit_commit();
+  if (ret != RET_OK) {
+    // e.g. a channel that never moved, so has no range
+    LOG_WARN("Calibration rejected (%s), limits unchanged\r\n", err_to_str(ret));
+  }
+
+  //Print the results
+  for (controller = 0; controller < RC_NUMBER_CONTROLLERS; controller++) {
+    LOG_MESSAGE(LOG_CHANNEL_CONSOLE, "Controller %d\r\n", controller+1);
+    for (channel = 0; channel < RC_NUMBER_CHANNELS; channel++) {
+      LOG_MESSAGE(LOG_CHANNEL_CONSOLE, "\tChannel %d: min: %.2fs, max: %.2fs, range: %.2fs\r\n",
+      channel+1,
+      limits[controller][channel].min,
+      limits[controller][channel].max,
+      limits[controller][channel].max -
+      limits[controller][channel].min
+    );
+    }
+  }
+
+  // De-activate task to prevent further repititions
+  args->tasks[TASK_CALIBRATE_CHANNELS_ID].active = false;
+}
+#endif
+
+#ifdef TASK_FLIGHT_LOG
+/**
+* @brief Write full flight log blocks to the LocalFileSystem.
+* @note Runs at low priority, the control loop only ever copies records into
+*       the current block and signals this task when a block is full.
+* @note Every LocalFileSystem call is semihosted and stops the whole CPU, so
+*       the file is only opened and written while the flight log is not held,
+*       i.e. while disarmed.
+* @param [in/out] targs Thread arguments.
+*/
+void task_flight_log(const void *targs) {
+  thread_args_t * args = (thread_args_t *) targs;
+  task_start(args, TASK_FLIGHT_LOG_ID);
+
+  FILE *file = NULL;
+  bool open_failed = false;
+
+  args->flight_log->writer = &args->threads[TASK_FLIGHT_LOG_ID];
+
   while (args->active) {
-    // args->serial->printf("t %d is %s\r\n", TASK_CALIBRATE_CHANNELS, args->tasks[TASK_CALIBRATE_CHANNELS].active ? "true" : "false");
-    if (args->tasks[TASK_CALIBRATE_CHANNELS_ID].active == true) {
-      args->serial->printf("t %d is %s\r\n", TASK_CALIBRATE_CHANNELS_ID, args->tasks[TASK_CALIBRATE_CHANNELS_ID].active ? "true" : "false");
+    Thread::signal_wait(FLIGHT_LOG_SIGNAL);
+    uint32_t start = task_iteration_begin(&args->tasks[TASK_FLIGHT_LOG_ID]);
+    if (!args->tasks[TASK_FLIGHT_LOG_ID].active) {
+      flight_log_flush(args->flight_log, NULL);
+    } else if (!args->flight_log->hold) {
+      // Not opened at boot, in case a warm restart came back armed
+      if (file == NULL && !open_failed) {
+        file = fopen(FLIGHT_LOG_PATH, "ab");
+        if (file == NULL) {
+          open_failed = true;
+          LOG_ERROR("ERROR: Could not open %s, flight log disabled.\r\n", FLIGHT_LOG_PATH);
+        }
+      }
+      flight_log_flush(args->flight_log, file);
+    }
+    task_iteration_end(&args->tasks[TASK_FLIGHT_LOG_ID], start);
+  }
+
+  if (file != NULL && !args->flight_log->hold) {
+    fclose(file);
+  }
+}
+#endif
 
-      args->serial->printf("Controller calibration beginning,\r\n");
-      args->serial->printf("move controller sticks & switches to extremities.\r\n");
-      calibration_time = calibration_time_ms;
+/**
+* @brief Track the stack high water mark of every task, and heap use.
+* @details Warns once each time a task's peak grows to within
+*          STACK_MARGIN_PERCENT of its stack size. "task stack" shows the
+*          peaks and a recommended size for each task, "mem" shows the rest.
+* @param [in/out] targs Thread arguments.
+*/
+#ifdef TASK_STACK_MONITOR
+void task_stack_monitor(const void *targs) {
+  thread_args_t * args = (thread_args_t *) targs;
+  task_start(args, TASK_STACK_MONITOR_ID);
+  unsigned t;
 
-      // Set all limits to extremes
-      for (controller = 0; controller < RC_NUMBER_CONTROLLERS; controller++) {
-        for (channel = 0; channel < RC_NUMBER_CHANNELS; channel++) {
-          args->channel_limits[controller][channel].min = 10000.0f;
-          args->channel_limits[controller][channel].max = -10000.0f;
+  while (args->active) {
+    if (args->tasks[TASK_STACK_MONITOR_ID].active) {
+      uint32_t start = task_iteration_begin(&args->tasks[TASK_STACK_MONITOR_ID]);
+      for (t = 0; t < NUM_TASKS; t++) {
+        if (task_stack_sample(args, t) && task_stack_low(&args->tasks[t])) {
+          LOG_WARN("Stack of task %d (%s) is low: %lu of %lu bytes used\r\n",
+            t, args->tasks[t].name, (unsigned long) args->tasks[t].stack_peak, (unsigned long) args->tasks[t].stack_size);
         }
       }
+      mem_stats_sample(args);
+      task_iteration_end(&args->tasks[TASK_STACK_MONITOR_ID], start);
+    }
+    task_sleep(&args->tasks[TASK_STACK_MONITOR_ID]);
+  }
+}
+#endif
 
-      // Find min and max pulsewidths for each channel
-      while(calibration_time > 0) {
+/**
+* @brief Kick the watchdog only while every supervised task is alive.
+* @details A task is supervised if it has a heartbeat_ms and is active. It must
+*          finish an iteration within heartbeat_ms (or two of its periods, if
+*          "task rate" has slowed it down further). Otherwise the ESCs are
+*          stopped, the name of the task is recorded and the watchdog is left
+*          to reset the system.
+* @param [in/out] targs Thread arguments.
+*/
+#ifdef TASK_SUPERVISOR
+void task_supervisor(const void *targs) {
+  thread_args_t * args = (thread_args_t *) targs;
+  task_start(args, TASK_SUPERVISOR_ID);
+
+  uint32_t last_seen_us[NUM_TASKS];
+  bool failed = false;
+  unsigned t;
+
+  for (t = 0; t < NUM_TASKS; t++) {
+    last_seen_us[t] = us_ticker_read();
+  }
 
-        if(calibration_time % 1000 == 0){
-          // Countdown
-          args->serial->printf("%.0f...", calibration_time / 1000.0f);
+  while (args->active) {
+    if (args->tasks[TASK_SUPERVISOR_ID].active) {
+      uint32_t start = task_iteration_begin(&args->tasks[TASK_SUPERVISOR_ID]);
+      uint32_t now_us = us_ticker_read();
+      uint32_t heartbeats = task_heartbeats_take();
+
+      for (t = 0; t < NUM_TASKS; t++) {
+        const task_t *task = &args->tasks[t];
+        uint32_t window_ms = task->heartbeat_ms;
+
+        // Parked tasks are not expected to run
+        if (window_ms == 0 || !task->active || (heartbeats & (1UL << t))) {
+          last_seen_us[t] = now_us;
+          continue;
         }
 
-        for (controller = 0; controller < RC_NUMBER_CONTROLLERS; controller++) {
-          for (channel = 0; channel < RC_NUMBER_CHANNELS; channel++) {
-            tmp = args->receiver[controller].channel[channel]->pulsewidth();
-            // Find min
-            if (tmp < args->channel_limits[controller][channel].min) {
-              args->channel_limits[controller][channel].min = tmp;
-            }
-
-            // Find max
-            if (tmp > args->channel_limits[controller][channel].max) {
-              args->channel_limits[controller][channel].max = tmp;
-            }
+        if (window_ms < 2 * task->period_ms) {
+          window_ms = 2 * task->period_ms;
+        }
+        if (now_us - last_seen_us[t] > window_ms * 1000) {
+          if (!failed) {
+            // Stop the ESCs now, rather than when the watchdog resets. The
+            // state is left alone, so the restart re-arms whichever task hung.
+            esc_gate_shut(args);
+            args->wdt->set_reset_reason(task->name);
+            LOG_ERROR("Task %d (%s) missed its heartbeat, waiting for watchdog reset\r\n", t, task->name);
+            failed = true;
           }
         }
-        Thread::wait(calibration_tick);
-        calibration_time -= calibration_tick;
       }
 
-      // End countdown
-      args->serial->printf("\r\n");
-
-      //Print the results
-      for (controller = 0; controller < RC_NUMBER_CONTROLLERS; controller++) {
-        args->serial->printf("Controller %d\r\n", controller+1);
-        for (channel = 0; channel < RC_NUMBER_CHANNELS; channel++) {
-          args->serial->printf("\tChannel %d: min: %.2fs, max: %.2fs, range: %.2fs\r\n",
-          channel+1,
-          args->channel_limits[controller][channel].min,
-          args->channel_limits[controller][channel].max,
-          args->channel_limits[controller][channel].max -
-          args->channel_limits[controller][channel].min
-        );
-        }
+      // Once a task has failed, stop kicking for good
+      if (!failed) {
+        args->wdt->kick();
       }
+      task_iteration_end(&args->tasks[TASK_SUPERVISOR_ID], start);
+    }
+    task_sleep(&args->tasks[TASK_SUPERVISOR_ID]);
+  }
+}
+#endif
 
-      // De-activate task to prevent further repititions
-      args->tasks[TASK_CALIBRATE_CHANNELS_ID].active = false;
+#ifdef TASK_LOG
+/**
+* @brief Format and write out the messages queued by LOG() and friends.
+* @note Runs at low priority, so that the UART never holds up the tasks
+*       doing the logging.
+* @param [in/out] targs Thread arguments.
+*/
+void task_log(const void *targs) {
+  thread_args_t * args = (thread_args_t *) targs;
+  task_start(args, TASK_LOG_ID);
 
-    }
+  log_queue_init(&args->threads[TASK_LOG_ID]);
 
-    // No need to poll continuously
-    Thread::wait(500);
+  while (args->active) {
+    log_queue_wait(LOG_QUEUE_IDLE_MS);
+    uint32_t start = task_iteration_begin(&args->tasks[TASK_LOG_ID]);
+    // Echo first, so a command's reply comes after the echoed line ending
+    cli_echo_flush(args->serial);
+    log_queue_flush(args->serial);
+    task_iteration_end(&args->tasks[TASK_LOG_ID], start);
   }
 }
 #endif
@@ -673,19 +1063,19 @@ void task_debug(const void *targs) {
   float tmp;
 
   while (args->active) {
-    args->serial->printf("Debug\r\n");
+    LOG_DEBUG("Debug\r\n");
     // args->serial->printf("t %d is %s\r\n", TASK_CALIBRATE_CHANNELS, args->tasks[TASK_CALIBRATE_CHANNELS].active ? "true" : "false");
     if (args->tasks[TASK_DEBUG_ID].active == true) {
       for (controller = 0; controller < RC_NUMBER_CONTROLLERS; controller++) {
         for (channel = 0; channel < RC_NUMBER_CHANNELS; channel++) {
           tmp = args->receiver[controller].channel[channel]->pulsewidth();
-          printf("ctrl'r: %d, chan: %d, pulse: %.0f\r\n", controller, channel, tmp);
+          LOG_DEBUG("ctrl'r: %d, chan: %d, pulse: %.0f\r\n", controller, channel, tmp);
         }
       }
     }
 
     // No need to poll continuously
-    Thread::wait(1000);
+    task_sleep(&args->tasks[TASK_DEBUG_ID]);
   }
 }
 #endif
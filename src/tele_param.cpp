@@ -19,7 +19,7 @@
  * @author Cameron A. Craig
  * @date 10 Nov 2017
  * @copyright 2017 Cameron A. Craig
- * @brief String conversion functions for tele_param_*_t.
+ * @brief String conversion and aggregation functions for tele_param_*_t.
  */
 
 #include "tele_param.h"
@@ -38,3 +38,28 @@ const char* tele_command_type_to_string(tele_command_type_t tctid){
 const char* tele_command_unit_to_string(tele_command_unit_t tcuid){
   return tele_command_unit_str[tcuid];
 }
+
+void tele_aggregate_reset(tele_aggregate_t *window) {
+  window->min = 0.0f;
+  window->max = 0.0f;
+  window->sum = 0.0f;
+  window->count = 0;
+}
+
+void tele_aggregate_add(tele_aggregate_t *window, float sample) {
+  if (window->count == 0 || sample < window->min) {
+    window->min = sample;
+  }
+  if (window->count == 0 || sample > window->max) {
+    window->max = sample;
+  }
+  window->sum += sample;
+  window->count++;
+}
+
+float tele_aggregate_mean(const tele_aggregate_t *window) {
+  if (window->count == 0) {
+    return 0.0f;
+  }
+  return window->sum / window->count;
+}
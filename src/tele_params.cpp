@@ -0,0 +1,172 @@
+/* Copyright (c) 2018 Cameron A. Craig, MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ * BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * @file tele_params.cpp
+ * @author Cameron A. Craig
+ * @date 14 Feb 2018
+ * @copyright 2018 Cameron A. Craig
+ * @brief Defines the telemetry parameters and their getters/setters.
+ */
+
+#include "mbed.h"
+#include "tele_params.h"
+#include "thread_args.h"
+#include "tasks.h"
+#include "mem_stats.h"
+#include "bno055.h"
+#include "lookup.h"
+#include "weapon_rpm.h"
+
+#define TELE_PARAM_ENTRY(id, name, unit, type, aggregate, get, set) \
+  {id, name, unit, type, aggregate, get, set},
+
+tele_command_t tele_commands[NUM_TELE_COMMANDS] = {
+  TELE_PARAMS(TELE_PARAM_ENTRY)
+};
+
+static lookup_table_t tele_lookup;
+
+static const char * tele_param_name(unsigned index) {
+  return tele_commands[index].name;
+}
+
+bool tele_params_init(void) {
+  return lookup_build(&tele_lookup, tele_param_name, NUM_TELE_COMMANDS);
+}
+
+tele_command_t * tele_param_get(unsigned id) {
+  if (id >= NUM_TELE_COMMANDS) {
+    return NULL;
+  }
+  return &tele_commands[id];
+}
+
+tele_command_t * tele_param_find(const char *name, size_t len) {
+  int index = lookup_find(&tele_lookup, name, len);
+  return (index < 0) ? NULL : &tele_commands[index];
+}
+
+#ifdef DEVICE_BNO055
+/* Taken by tele_params_sample(), only used on the telemetry thread */
+static euler_t tele_accel;
+static euler_t tele_euler;
+#endif
+
+void tele_params_sample(const void *targs) {
+#ifdef DEVICE_BNO055
+  tele_accel = bno055_read_accel();
+  tele_euler = bno055_read_euler_angles();
+#endif
+}
+
+#ifdef DEVICE_BNO055
+void tele_get_accel_x(const void *targs, tele_value_t *value) {
+  value->f = tele_accel.x;
+}
+
+void tele_get_accel_y(const void *targs, tele_value_t *value) {
+  value->f = tele_accel.y;
+}
+
+void tele_get_accel_z(const void *targs, tele_value_t *value) {
+  value->f = tele_accel.z;
+}
+
+void tele_get_pitch(const void *targs, tele_value_t *value) {
+  value->f = tele_euler.pitch;
+}
+
+void tele_get_roll(const void *targs, tele_value_t *value) {
+  value->f = tele_euler.roll;
+}
+
+void tele_get_yaw(const void *targs, tele_value_t *value) {
+  value->f = tele_euler.heading;
+}
+
+void tele_get_temp(const void *targs, tele_value_t *value) {
+  value->i = bno055_read_temp();
+}
+#endif
+
+void tele_get_weapon_rpm_1(const void *targs, tele_value_t *value) {
+  value->f = weapon_rpm_read(0);
+}
+
+void tele_get_weapon_rpm_2(const void *targs, tele_value_t *value) {
+  value->f = weapon_rpm_read(1);
+}
+
+void tele_get_weapon_rpm_3(const void *targs, tele_value_t *value) {
+  value->f = weapon_rpm_read(2);
+}
+
+void tele_get_deadline_misses(const void *targs, tele_value_t *value) {
+  thread_args_t *args = (thread_args_t *) targs;
+  unsigned t;
+  value->i = 0;
+  for (t = 0; t < NUM_TASKS; t++) {
+    value->i += args->tasks[t].stats.deadline_misses;
+  }
+}
+
+void tele_get_control_wcrt(const void *targs, tele_value_t *value) {
+#ifdef TASK_MOTOR_DRIVE
+  thread_args_t *args = (thread_args_t *) targs;
+  value->i = args->tasks[TASK_MOTOR_DRIVE_ID].stats.worst_response_us;
+#elif defined(TASK_EXECUTIVE)
+  // The control loop is the first slot of every frame
+  thread_args_t *args = (thread_args_t *) targs;
+  value->i = args->tasks[TASK_EXECUTIVE_ID].stats.worst_response_us;
+#else
+  value->i = 0;
+#endif
+}
+
+#ifdef TASK_STACK_MONITOR
+/* Memory parameters read the last sample taken by the stack monitor task */
+
+void tele_get_heap_used(const void *targs, tele_value_t *value) {
+  mem_stats_t stats;
+  mem_stats_get(&stats);
+  value->i = stats.heap_current;
+}
+
+void tele_get_heap_peak(const void *targs, tele_value_t *value) {
+  mem_stats_t stats;
+  mem_stats_get(&stats);
+  value->i = stats.heap_peak;
+}
+
+void tele_get_heap_allocs(const void *targs, tele_value_t *value) {
+  mem_stats_t stats;
+  mem_stats_get(&stats);
+  value->i = stats.alloc_count;
+}
+
+void tele_get_isr_stack_peak(const void *targs, tele_value_t *value) {
+  mem_stats_t stats;
+  mem_stats_get(&stats);
+  value->i = stats.isr_stack_peak;
+}
+
+void tele_get_task_stack_peak(const void *targs, tele_value_t *value) {
+  mem_stats_t stats;
+  mem_stats_get(&stats);
+  value->i = stats.task_stack_peak_percent;
+}
+#endif
@@ -24,7 +24,15 @@
 
 #include "utils.h"
 
-bool is_drive_stalled(thread_args_t *args){
+PwmIn *drive_stall_channel(thread_args_t *args) {
+  return args->receiver[1].channel[RC_1_AILERON];
+}
+
+PwmIn *weapon_stall_channel(thread_args_t *args) {
+  return args->receiver[0].channel[RC_0_THROTTLE];
+}
+
+bool is_drive_stalled(thread_args_t *args, int timeout_ms){
   /* We have averted an extremely dangerous situation by also checking if (stall_time < 0).
     Confused?  What happens if stallTimer overflows? It becomes negative.
     If the last known controller positions were in the arming positions,
@@ -32,11 +40,11 @@ bool is_drive_stalled(thread_args_t *args){
     Disaster averted :)
     */
 
-  int stall_time = args->receiver[1].channel[RC_1_AILERON]->stallTimer.read_ms();
-  return  (stall_time > 200) || (stall_time < 0);
+  int stall_time = drive_stall_channel(args)->stallTimer.read_ms();
+  return  (stall_time > timeout_ms) || (stall_time < 0);
 }
 
-bool is_weapon_stalled(thread_args_t *args){
+bool is_weapon_stalled(thread_args_t *args, int timeout_ms){
   /* We have averted an extremely dangerous situation by also checking if (stall_time < 0).
     Confused?  What happens if stallTimer overflows? It becomes negative.
     If the last known controller positions were in the arming positions,
@@ -44,6 +52,6 @@ bool is_weapon_stalled(thread_args_t *args){
     Disaster averted :)
     */
 
-  int stall_time = args->receiver[0].channel[RC_0_THROTTLE]->stallTimer.read_ms();
-  return  (stall_time > 200) || (stall_time < 0);
+  int stall_time = weapon_stall_channel(args)->stallTimer.read_ms();
+  return  (stall_time > timeout_ms) || (stall_time < 0);
 }
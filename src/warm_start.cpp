@@ -0,0 +1,205 @@
+/* Copyright (c) 2018 Cameron A. Craig, MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ * BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * @file warm_start.cpp
+ * @author Cameron A. Craig
+ * @date 14 Mar 2018
+ * @copyright 2018 Cameron A. Craig
+ * @brief Control state kept in no-init RAM, to resume quickly after a watchdog reset.
+ */
+
+#include "mbed.h"
+#include "warm_start.h"
+#include "return_codes.h"
+
+/* The AHB SRAM banks are not cleared by the C library at start up, and keep
+   their contents through a watchdog reset. Bank 0 is reserved for USB,
+   which we don't use. */
+#define WARM_START_SECTION __attribute__((section("AHBSRAM0")))
+
+/* Marks a slot as holding a complete record */
+#define WARM_START_MAGIC 0x5741524DUL
+
+typedef struct {
+  uint32_t magic;
+  uint32_t sequence;
+  /*! CRC-32 of the payload, mixed with the sequence number. */
+  uint32_t crc;
+} warm_header_t;
+
+typedef struct {
+  warm_header_t header;
+  warm_control_t control;
+} warm_control_slot_t;
+
+typedef struct {
+  warm_header_t header;
+  settings_t settings;
+} warm_settings_slot_t;
+
+/* Each record is written to alternate slots, so a reset part way through
+   a write leaves the previous record intact. */
+typedef struct {
+  warm_control_slot_t control[2];
+  warm_settings_slot_t settings[2];
+} warm_start_t;
+
+static warm_start_t warm_start WARM_START_SECTION;
+
+/* Sequence number of the next record to write */
+static uint32_t control_sequence = 0;
+static uint32_t settings_sequence = 0;
+
+/**
+* @brief CRC-32 (IEEE), a nibble at a time to keep the table small.
+*/
+static uint32_t warm_start_crc32(const void *data, size_t len) {
+  static const uint32_t table[16] = {
+    0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC,
+    0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+    0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+    0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+  };
+  const uint8_t *bytes = (const uint8_t *) data;
+  uint32_t crc = 0xFFFFFFFF;
+
+  while (len--) {
+    crc ^= *bytes++;
+    crc = (crc >> 4) ^ table[crc & 0x0F];
+    crc = (crc >> 4) ^ table[crc & 0x0F];
+  }
+  return ~crc;
+}
+
+/**
+* @brief Write a record into a slot, invalidating the slot while it changes.
+*/
+static void warm_start_write(warm_header_t *header, void *slot_payload,
+                             const void *payload, size_t len, uint32_t sequence) {
+  header->magic = 0;
+  __DMB();
+  memcpy(slot_payload, payload, len);
+  header->sequence = sequence;
+  header->crc = warm_start_crc32(slot_payload, len) ^ sequence;
+  __DMB();
+  header->magic = WARM_START_MAGIC;
+}
+
+static bool warm_start_valid(const warm_header_t *header, const void *payload, size_t len) {
+  return header->magic == WARM_START_MAGIC &&
+         header->crc == (warm_start_crc32(payload, len) ^ header->sequence);
+}
+
+/**
+* @brief Pick the newest valid slot of a record.
+* @return Slot index, or -1 if neither slot is valid.
+*/
+static int warm_start_newest(bool valid0, uint32_t sequence0, bool valid1, uint32_t sequence1) {
+  if (valid0 && valid1) {
+    // Signed difference copes with the sequence wrapping
+    return ((int32_t) (sequence1 - sequence0) > 0) ? 1 : 0;
+  }
+  if (valid0) {
+    return 0;
+  }
+  return valid1 ? 1 : -1;
+}
+
+static int warm_start_newest_control(void) {
+  return warm_start_newest(
+    warm_start_valid(&warm_start.control[0].header, &warm_start.control[0].control, sizeof(warm_control_t)),
+    warm_start.control[0].header.sequence,
+    warm_start_valid(&warm_start.control[1].header, &warm_start.control[1].control, sizeof(warm_control_t)),
+    warm_start.control[1].header.sequence);
+}
+
+static int warm_start_newest_settings(void) {
+  return warm_start_newest(
+    warm_start_valid(&warm_start.settings[0].header, &warm_start.settings[0].settings, sizeof(settings_t)),
+    warm_start.settings[0].header.sequence,
+    warm_start_valid(&warm_start.settings[1].header, &warm_start.settings[1].settings, sizeof(settings_t)),
+    warm_start.settings[1].header.sequence);
+}
+
+void warm_start_save_control(const thread_args_t *args) {
+  warm_control_t control;
+  control.state = args->state;
+  control.orientation_detected = args->orientation_detected;
+  control.orientation_override = args->orientation_override;
+  control.inverted = args->inverted;
+  control.heading_lock_enabled = args->heading_lock_enabled;
+  control.heading_lock = args->heading_lock;
+  control.outputs = args->outputs;
+
+  warm_control_slot_t *slot = &warm_start.control[control_sequence & 1];
+  warm_start_write(&slot->header, &slot->control, &control, sizeof(control), control_sequence);
+  control_sequence++;
+}
+
+void warm_start_save_settings(const settings_t *settings) {
+  warm_settings_slot_t *slot = &warm_start.settings[settings_sequence & 1];
+  warm_start_write(&slot->header, &slot->settings, settings, sizeof(settings_t), settings_sequence);
+  settings_sequence++;
+}
+
+bool warm_start_available(void) {
+  int control = warm_start_newest_control();
+  if (control < 0 || warm_start_newest_settings() < 0) {
+    return false;
+  }
+  return warm_start.control[control].control.state <= STATE_FULLY_ARMED;
+}
+
+void warm_start_restore(thread_args_t *args) {
+  int control = warm_start_newest_control();
+  int settings = warm_start_newest_settings();
+  const warm_control_t *saved = &warm_start.control[control].control;
+
+  // Carry on from the restored records, rather than overwriting them
+  control_sequence = warm_start.control[control].header.sequence + 1;
+  settings_sequence = warm_start.settings[settings].header.sequence + 1;
+
+  // Settings that no longer pass validation are not trusted to drive with
+  if (settings_restore(&warm_start.settings[settings].settings) != RET_OK) {
+    return;
+  }
+
+  // Re-armed through the state machine, so the change is recorded
+  if (saved->state == STATE_DRIVE_ONLY || saved->state == STATE_FULLY_ARMED) {
+    state_raise(&args->state, STATE_EVENT_WATCHDOG_DRIVE);
+  }
+  if (saved->state == STATE_WEAPON_ONLY || saved->state == STATE_FULLY_ARMED) {
+    state_raise(&args->state, STATE_EVENT_WATCHDOG_WEAPON);
+  }
+  args->orientation_detected = saved->orientation_detected;
+  args->orientation_override = saved->orientation_override;
+  args->inverted = saved->inverted;
+  args->heading_lock_enabled = saved->heading_lock_enabled;
+  args->heading_lock = saved->heading_lock;
+  args->outputs = saved->outputs;
+}
+
+void warm_start_reset(void) {
+  warm_start.control[0].header.magic = 0;
+  warm_start.control[1].header.magic = 0;
+  warm_start.settings[0].header.magic = 0;
+  warm_start.settings[1].header.magic = 0;
+
+  settings_t settings;
+  settings_read(&settings);
+  warm_start_save_settings(&settings);
+}
@@ -41,3 +41,35 @@ void Watchdog::kick(void) {
 bool Watchdog::is_wdt_reset(void) {
   return (LPC_WDT->WDMOD >> 2) & 1;
 }
+
+/* Marks the general purpose registers as holding a reset reason */
+#define WATCHDOG_REASON_MAGIC 0x57445252UL
+
+void Watchdog::set_reset_reason(const char *reason) {
+  uint32_t words[WATCHDOG_REASON_LEN / 4];
+  memset(words, 0, sizeof(words));
+  strncpy((char *) words, reason, WATCHDOG_REASON_LEN);
+
+  LPC_RTC->GPREG1 = words[0];
+  LPC_RTC->GPREG2 = words[1];
+  LPC_RTC->GPREG3 = words[2];
+  LPC_RTC->GPREG4 = words[3];
+  LPC_RTC->GPREG0 = WATCHDOG_REASON_MAGIC;
+}
+
+bool Watchdog::take_reset_reason(char *reason) {
+  if (LPC_RTC->GPREG0 != WATCHDOG_REASON_MAGIC) {
+    return false;
+  }
+
+  uint32_t words[WATCHDOG_REASON_LEN / 4];
+  words[0] = LPC_RTC->GPREG1;
+  words[1] = LPC_RTC->GPREG2;
+  words[2] = LPC_RTC->GPREG3;
+  words[3] = LPC_RTC->GPREG4;
+  memcpy(reason, words, WATCHDOG_REASON_LEN);
+  reason[WATCHDOG_REASON_LEN] = '\0';
+
+  LPC_RTC->GPREG0 = 0;
+  return true;
+}
@@ -0,0 +1,99 @@
+/* Copyright (c) 2018 Cameron A. Craig, MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ * BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * @file weapon_rpm.cpp
+ * @author Cameron A. Craig
+ * @date 26 Mar 2018
+ * @copyright 2018 Cameron A. Craig
+ * @brief Measures weapon motor speed from a tachometer pulse on each motor.
+ */
+
+#include "mbed.h"
+#include "weapon_rpm.h"
+#include "config.h"
+
+/**
+ * Edge timing of one tachometer, only written by its interrupt.
+ */
+typedef struct {
+  InterruptIn *pin;
+  /*! us_ticker time of the latest edge. */
+  volatile uint32_t last_edge_us;
+  /*! Time taken by the last whole revolution (us), 0 until one is seen. */
+  volatile uint32_t revolution_us;
+  /*! Start of the revolution being timed. */
+  uint32_t revolution_start_us;
+  uint32_t edges;
+} weapon_tacho_t;
+
+static weapon_tacho_t weapon_tachos[WEAPON_RPM_MOTORS];
+
+/**
+* @brief Count a tachometer edge.
+* @details Timing a whole revolution, rather than the gap between two pulses,
+*          evens out any unequal spacing of the magnets or motor poles.
+*/
+static void weapon_tacho_edge(weapon_tacho_t *tacho) {
+  uint32_t now = us_ticker_read();
+  tacho->last_edge_us = now;
+  if (++tacho->edges >= WEAPON_TACHO_PULSES_PER_REV) {
+    tacho->revolution_us = now - tacho->revolution_start_us;
+    tacho->revolution_start_us = now;
+    tacho->edges = 0;
+  }
+}
+
+static void weapon_tacho_edge_1(void) { weapon_tacho_edge(&weapon_tachos[0]); }
+static void weapon_tacho_edge_2(void) { weapon_tacho_edge(&weapon_tachos[1]); }
+static void weapon_tacho_edge_3(void) { weapon_tacho_edge(&weapon_tachos[2]); }
+
+void weapon_rpm_init(void) {
+  static const PinName pins[WEAPON_RPM_MOTORS] = {
+    WEAPON_TACHO_1_PIN, WEAPON_TACHO_2_PIN, WEAPON_TACHO_3_PIN
+  };
+  static void (* const edges[WEAPON_RPM_MOTORS])(void) = {
+    weapon_tacho_edge_1, weapon_tacho_edge_2, weapon_tacho_edge_3
+  };
+  unsigned m;
+
+  memset(weapon_tachos, 0x00, sizeof(weapon_tachos));
+  for (m = 0; m < WEAPON_RPM_MOTORS; m++) {
+    if (pins[m] == NC) {
+      continue;
+    }
+    weapon_tachos[m].pin = new InterruptIn(pins[m]);
+    weapon_tachos[m].pin->rise(edges[m]);
+  }
+}
+
+bool weapon_rpm_sensed(unsigned motor) {
+  return motor < WEAPON_RPM_MOTORS && weapon_tachos[motor].pin != NULL;
+}
+
+int32_t weapon_rpm_read(unsigned motor) {
+  if (!weapon_rpm_sensed(motor)) {
+    return 0;
+  }
+
+  const weapon_tacho_t *tacho = &weapon_tachos[motor];
+  uint32_t revolution_us = tacho->revolution_us;
+  if (revolution_us == 0 ||
+      us_ticker_read() - tacho->last_edge_us > WEAPON_TACHO_TIMEOUT_MS * 1000U) {
+    return 0;
+  }
+  return 60000000U / revolution_us;
+}